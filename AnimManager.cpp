@@ -200,8 +200,12 @@ bool AnimManager::destroy_anim(NuvieAnim *anim_pt)
  */
 void AnimManager::drawTile(Tile *tile, uint16 x, uint16 y)
 {
-    viewsurf->blit(mapwindow_x_offset+x, mapwindow_y_offset+y, tile->data, 8, tile_pitch, tile_pitch, 16,
-                   tile->transparent, &viewport);
+    if(tile_pitch == TILE_WIDTH)
+        viewsurf->blit_tile(mapwindow_x_offset+x, mapwindow_y_offset+y, tile,
+                            map_window->get_tile_manager()->get_native_tile(tile), &viewport);
+    else
+        viewsurf->blit(mapwindow_x_offset+x, mapwindow_y_offset+y, tile->data, 8, tile_pitch, tile_pitch, 16,
+                       tile->transparent, &viewport);
 }
 
 void AnimManager::drawText(Font *font, const char *text, uint16 x, uint16 y)
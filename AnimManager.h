@@ -50,6 +50,7 @@ public:
 
     void update();
     void display(bool top_anims = false);
+    bool has_anims() { return !anim_list.empty(); }
 
     Screen *get_surface()            { return(viewsurf); }
     void set_surface(Screen *screen) { viewsurf = screen; }
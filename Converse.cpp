@@ -24,7 +24,7 @@
 #include "Game.h"
 #include "Configuration.h"
 #include "U6misc.h"
-#include "U6Lzw.h"
+#include "U6Lib_n.h"
 #include "Player.h"
 #include "Party.h"
 #include "ViewManager.h"
@@ -758,33 +758,23 @@ ConvScript::~ConvScript()
  */
 void ConvScript::read_script()
 {
-    unsigned char *undec_script = 0; // item as it appears in library
     unsigned char *dec_script = 0; // decoded
-    uint32 undec_len = 0, dec_len = 0;
-    U6Lzw decoder;
+    uint32 undec_len = 0, dec_len = 0; // item size as it appears in library, and decoded
     uint8 gametype=src->get_game_type();
 
     undec_len = src->get_item_size(src_index);
     if(undec_len > 4)
     {
-	undec_script = src->get_item(src_index);
 	if (gametype==NUVIE_GAME_U6) {
-	    // decode
-	    if(!(undec_script[0] == 0 && undec_script[1] == 0
-			&& undec_script[2] == 0 && undec_script[3] == 0))
+	    // decode, through the library cache as NPCs are often talked to again
+	    U6LibCacheItem *item = U6LibCache::get_cache()->get_item(src, src_index);
+	    if(item != NULL)
 	    {
-		compressed = true;
-		dec_script =
-		    decoder.decompress_buffer(undec_script, undec_len, dec_len);
-		free(undec_script);
-	    }
-	    else
-	    {
-		compressed = false;
-		dec_len = undec_len - 4;
+		compressed = item->lzw_decoded;
+		dec_len = item->size;
 		dec_script = (unsigned char *)malloc(dec_len);
-		memcpy(dec_script, undec_script + 4, dec_len);
-		free(undec_script);
+		memcpy(dec_script, item->data, dec_len);
+		U6LibCache::get_cache()->release(item);
 	    }
 	}
 	else
@@ -792,7 +782,7 @@ void ConvScript::read_script()
 	    // MD/SE compression handled by lzc library
 		compressed = false;
 		dec_len = undec_len;
-		dec_script = undec_script;
+		dec_script = src->get_item(src_index);
 	}
     }
     if(dec_len)
@@ -26,7 +26,6 @@
 #include "Configuration.h"
 #include "NuvieIO.h"
 #include "U6Lib_n.h"
-#include "U6Lzw.h"
 
 #include "ConverseSpeech.h"
 #include "SoundManager.h"
@@ -110,25 +109,22 @@ void ConverseSpeech::play_speech(uint16 actor_num, uint16 sample_num)
 
 NuvieIOBuffer *ConverseSpeech::load_speech(std::string filename, uint16 sample_num)
 {
- unsigned char *compressed_data, *raw_audio, *wav_data;
+ unsigned char *raw_audio, *wav_data;
  sint16 *converted_audio;
  uint32 decomp_size;
  uint32 upsampled_size;
  sint16 sample=0, prev_sample;
- U6Lib_n sam_file;
- U6Lzw lzw;
+ U6LibCacheItem *sample_item;
  NuvieIOBuffer *wav_buffer = 0;
  uint32 j, k;
  
- sam_file.open(filename, 4);
+ sample_item = U6LibCache::get_cache()->get_item(filename, sample_num);
  
- compressed_data = sam_file.get_item(sample_num, NULL);
- raw_audio = lzw.decompress_buffer(compressed_data, sam_file.get_item_size(sample_num), decomp_size);
- 
- free(compressed_data);
- 
- if(raw_audio != NULL)
+ if(sample_item != NULL)
   {
+   raw_audio = sample_item->data;
+   decomp_size = sample_item->size;
+
    wav_buffer = new NuvieIOBuffer();
    upsampled_size = decomp_size + (int)floor((decomp_size - 1) / 4) * (2 + 2 + 2 + 1);
 
@@ -176,7 +172,7 @@ NuvieIOBuffer *ConverseSpeech::load_speech(std::string filename, uint16 sample_n
    converted_audio[k] = sample;
   }
  
- free(raw_audio);
+ U6LibCache::get_cache()->release(sample_item);
   
  return wav_buffer;
 }
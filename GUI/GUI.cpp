@@ -191,6 +191,23 @@ bool GUI::moveWidget(GUI_Widget *widget, uint32 dx, uint32 dy)
  return true;
 }
 
+/* Add the areas of the visible widgets that are drawn after `widget' to
+ * `areas'.
+ */
+void GUI::get_areas_above(GUI_Widget *widget, std::vector<SDL_Rect> &areas)
+{
+ int i;
+
+ for(i=0; i<numwidgets && widgets[i] != widget; ++i)
+   ;
+
+ for(++i; i<numwidgets; ++i)
+   {
+    if(widgets[i]->Status() == WIDGET_VISIBLE)
+      areas.push_back(widgets[i]->area);
+   }
+}
+
 void GUI::force_full_redraw()
 {
  full_redraw = true;
@@ -206,8 +223,11 @@ void GUI::Display()
 	if (dragging || full_redraw)
 		complete_redraw = true;
 
+	redrawn_areas.clear();
 	for ( i=0; i<numwidgets; ++i ) {
 		if ( widgets[i]->Status() == WIDGET_VISIBLE ) {
+			if (complete_redraw || widgets[i]->needs_redraw())
+				redrawn_areas.push_back(widgets[i]->area);
 			widgets[i]->Display(complete_redraw);
       //screen->update(widgets[i]->area.x,widgets[i]->area.y,widgets[i]->area.w,widgets[i]->area.h);
 		}
@@ -27,6 +27,8 @@
 #ifndef _GUI_h
 #define _GUI_h
 
+#include <vector>
+
 #include "SDL.h"
 #include "GUI_status.h"
 #include "GUI_DragManager.h"
@@ -77,6 +79,7 @@ protected:
   bool dragging;
 
   bool full_redraw; //this forces all widgets to redraw on the next call to Display()
+  std::vector<SDL_Rect> redrawn_areas; // widgets that needed redrawing so far in Display()
 
   // some default colours
   GUI_Color *selected_color;
@@ -97,6 +100,8 @@ public:
   bool removeWidget(GUI_Widget *widget);
 
   bool moveWidget(GUI_Widget *widget, uint32 dx, uint32 dy);
+  void get_areas_above(GUI_Widget *widget, std::vector<SDL_Rect> &areas);
+  const std::vector<SDL_Rect> &get_redrawn_areas() { return redrawn_areas; }
 
   /* force everything to redraw */
   void force_full_redraw();
@@ -70,6 +70,7 @@
 #include "Book.h"
 #include "Keys.h"
 #include "Utils.h"
+#include "U6Lib_n.h"
 
 #include "Game.h"
 
@@ -203,10 +204,17 @@ Game::~Game()
     if(magic) delete magic;
     if(book) delete book;
     if(keybinder) delete keybinder;
+
+    U6LibCache::get_cache()->print_stats();
 }
 
 bool Game::loadGame(Script *s)
 {
+   int asset_cache_size;
+
+   config->value("config/general/asset_cache_size", asset_cache_size, U6LIB_CACHE_DEFAULT_SIZE); // KB
+   U6LibCache::get_cache()->set_budget(asset_cache_size > 0 ? asset_cache_size * 1024 : 0);
+
    dither = new Dither(config);
 
    script = s;
@@ -703,6 +711,7 @@ void Game::play()
 
      screen->preformUpdate();
      sound_manager->update();
+     save_manager->update();
      event->wait();
    }
   return;
@@ -122,14 +122,14 @@ bool Map::is_passable(uint16 x, uint16 y, uint8 level)
  WRAP_COORD(x,level);
  WRAP_COORD(y,level);
 
- uint8 obj_status = obj_manager->is_passable(x, y, level);
- if(obj_status == OBJ_NOT_PASSABLE)
+ uint8 obj_flags = obj_manager->get_passable_flags(x, y, level);
+ if(obj_flags & OBJ_PASSCACHE_BLOCKED)
   {
    return false;
   }
 
 //special case for bridges, hacked doors and dungeon entrances etc.
- if(obj_status != OBJ_NO_OBJ && obj_manager->is_forced_passable(x, y, level))
+ if((obj_flags & OBJ_PASSCACHE_OBJ) && (obj_flags & OBJ_PASSCACHE_FORCED))
    return true;
 
  ptr = get_map_data(level);
@@ -164,14 +164,14 @@ bool Map::is_passable_from_dir(uint16 x, uint16 y, uint8 level, uint8 dir)
  WRAP_COORD(x,level);
  WRAP_COORD(y,level);
 
- uint8 obj_status = obj_manager->is_passable(x, y, level);
- if(obj_status == OBJ_NOT_PASSABLE)
+ uint8 obj_flags = obj_manager->get_passable_flags(x, y, level);
+ if(obj_flags & OBJ_PASSCACHE_BLOCKED)
   {
    return false;
   }
 
 //special case for bridges, hacked doors and dungeon entrances etc.
- if(obj_status != OBJ_NO_OBJ && obj_manager->is_forced_passable(x, y, level))
+ if((obj_flags & OBJ_PASSCACHE_OBJ) && (obj_flags & OBJ_PASSCACHE_FORCED))
    return true;
 
  ptr = get_map_data(level);
@@ -426,8 +426,8 @@ const char *Map::look(uint16 x, uint16 y, uint8 level)
 bool Map::loadMap(TileManager *tm, ObjManager *om)
 {
  std::string filename;
- NuvieIOFileRead map_file;
- NuvieIOFileRead chunks_file;
+ NuvieIOMapped map_file;
+ NuvieIOMapped chunks_file;
  unsigned char *map_data;
  unsigned char *map_ptr;
  unsigned char *chunk_data;
@@ -445,11 +445,12 @@ bool Map::loadMap(TileManager *tm, ObjManager *om)
  if(chunks_file.open(filename) == false)
    return false;
 
- map_data = map_file.readAll();
+ // both files are only needed while the map is unpacked, so read them in place.
+ map_data = map_file.get_raw_data();
  if(map_data == NULL)
    return false;
 
- chunk_data = chunks_file.readAll();
+ chunk_data = chunks_file.get_raw_data();
  if(chunk_data == NULL)
    return false;
 
@@ -475,9 +476,6 @@ if(surface == NULL)
     map_ptr += 1536;
    }
 
- free(map_data);
- free(chunk_data);
-
  if(roof_mode)
 	loadRoofData();
 
@@ -59,6 +59,8 @@
 
 #define WRAP_VIEWP(p,p1,s) ((p1-p) < 0 ? (p1-p) + s : p1-p)
 
+#define MAPWINDOW_ROOF_SIGNATURE 0x80000000 // roof tile numbers are signed with this bit set
+
 // This should make the mouse-cursor hovering identical to that in U6.
 static const uint8 movement_array[9 * 9] =
 {
@@ -153,6 +155,17 @@ MapWindow::MapWindow(Configuration *cfg, Map *m): GUI_Widget(NULL, 0, 0, 0, 0)
  map_width = map->get_width(cur_level);
 
  tmp_map_buf = NULL;
+ tmp_map_obj_boundary = NULL;
+ obj_boundary_x = obj_boundary_y = 0;
+ obj_boundary_level = 0;
+ obj_boundary_tile_revision = 0;
+ obj_boundary_valid = false;
+ draw_list_valid = false;
+ light_list_x = light_list_y = 0;
+ light_list_w = light_list_h = 0;
+ light_list_level = 0;
+ light_list_valid = false;
+ memset(obj_light, 0, sizeof(obj_light));
 
  selected_obj = NULL;
  look_obj = NULL;
@@ -179,6 +192,16 @@ MapWindow::MapWindow(Configuration *cfg, Map *m): GUI_Widget(NULL, 0, 0, 0, 0)
 
  lighting_update_required = true;
 
+ config->value("config/video/dirty_map_tiles", dirty_tiles, false);
+ signing = false;
+ partial_redraw = false;
+ cell_sig = NULL;
+ last_cell_sig = NULL;
+ cell_dirty = NULL;
+ cell_count = 0;
+ memset(&last_view, 0, sizeof(last_view));
+ sign_cycled_colours = true;
+
  set_interface();
 }
 
@@ -186,6 +209,10 @@ MapWindow::~MapWindow()
 {
  set_overlay(NULL); // free
  free(tmp_map_buf);
+ free(tmp_map_obj_boundary);
+ free(cell_sig);
+ free(last_cell_sig);
+ free(cell_dirty);
  delete anim_manager;
  if(roof_tiles)
  {
@@ -289,6 +316,11 @@ bool MapWindow::set_windowSize(uint16 width, uint16 height)
  if(tmp_map_buf == NULL)
    return false;
 
+ tmp_map_obj_boundary = (uint8 *)nuvie_realloc(tmp_map_obj_boundary, tmp_map_width * tmp_map_height);
+ if(tmp_map_obj_boundary == NULL)
+   return false;
+ obj_boundary_valid = false;
+
 // if(surface != NULL)
 //   delete surface;
 // surface = new Surface;
@@ -419,7 +451,7 @@ void MapWindow::moveLevel(uint8 new_level)
 {
  cur_level = new_level;
 
- updateBlacking();
+ refreshBlacking();
 }
 
 void MapWindow::moveMap(sint16 new_x, sint16 new_y, sint8 new_level, uint8 new_x_add, uint8 new_y_add)
@@ -442,7 +474,7 @@ void MapWindow::moveMap(sint16 new_x, sint16 new_y, sint8 new_level, uint8 new_x
  cur_level = new_level;
  cur_x_add = new_x_add;
  cur_y_add = new_y_add;
- updateBlacking();
+ refreshBlacking();
 
 }
 
@@ -856,33 +888,50 @@ void MapWindow::createLightOverlay()
 
 void MapWindow::updateLighting()
 {
-  uint16 x, y;
   if(using_map_tile_lighting)
   {
-    uint16 *ptr = tmp_map_buf;
-    for(y=0;y<tmp_map_height;y++)
+    sint32 tmp_x = cur_x - TMP_MAP_BORDER, tmp_y = cur_y - TMP_MAP_BORDER; // map location of tmp_map_buf[0]
+
+    if(!light_list_valid || light_list_level != cur_level
+       || tmp_x < light_list_x || tmp_x + tmp_map_width > light_list_x + light_list_w
+       || tmp_y < light_list_y || tmp_y + tmp_map_height > light_list_y + light_list_h)
+      buildLightList();
+
+    for(std::vector<LightSource>::iterator l = light_list.begin(); l != light_list.end(); l++)
     {
-      for(x=0;x<tmp_map_width;x++)
+      sint32 x = light_list_x + (*l).x - tmp_x;
+      sint32 y = light_list_y + (*l).y - tmp_y;
+      if(x < 0 || y < 0 || x >= tmp_map_width || y >= tmp_map_height)
+        continue;
+
+      uint16 tile_num = tmp_map_buf[x+y*tmp_map_width];
+      if(tile_num == 0) // in darkness
+        continue;
+
+      Tile *tile;
+      if((*l).map_tile)
       {
-        if(tmp_map_buf[x+y*tmp_map_width] != 0)
-        {
-          Tile *tile = tile_manager->get_tile(*ptr);
-          if(GET_TILE_LIGHT_LEVEL(tile) > 0)
-            screen->drawalphamap8globe(x-TMP_MAP_BORDER, y-TMP_MAP_BORDER, GET_TILE_LIGHT_LEVEL(tile));
+        tile = tile_manager->get_tile(tile_num);
+        if(GET_TILE_LIGHT_LEVEL(tile) > 0)
+          screen->drawalphamap8globe(x-TMP_MAP_BORDER, y-TMP_MAP_BORDER, GET_TILE_LIGHT_LEVEL(tile));
+      }
 
-          U6LList *obj_list =obj_manager->get_obj_list(cur_x-TMP_MAP_BORDER + x,cur_y - TMP_MAP_BORDER + y,cur_level); //FIXME wrapped coords.
-          if(obj_list)
+      if((*l).objs)
+      {
+        uint16 map_x = light_list_x + (*l).x, map_y = light_list_y + (*l).y;
+        WRAP_COORD(map_x, cur_level);
+        WRAP_COORD(map_y, cur_level);
+        U6LList *obj_list = obj_manager->get_obj_list(map_x, map_y, cur_level);
+        if(obj_list)
+        {
+          for(U6Link *link=obj_list->start();link != NULL;link=link->next)
           {
-            for(U6Link *link=obj_list->start();link != NULL;link=link->next)
-            {
-              Obj *obj = (Obj *)link->data;
-              tile = tile_manager->get_tile(obj_manager->get_obj_tile_num(obj)+obj->frame_n); //FIXME do we need to check the light for each tile in a multi-tile object.
-              if(GET_TILE_LIGHT_LEVEL(tile) > 0 && can_display_obj(x, y, obj))
-                screen->drawalphamap8globe( x-TMP_MAP_BORDER, y-TMP_MAP_BORDER, GET_TILE_LIGHT_LEVEL(tile) );
-            }
+            Obj *obj = (Obj *)link->data;
+            tile = tile_manager->get_tile(obj_manager->get_obj_tile_num(obj)+obj->frame_n); //FIXME do we need to check the light for each tile in a multi-tile object.
+            if(GET_TILE_LIGHT_LEVEL(tile) > 0 && can_display_obj(x, y, obj))
+              screen->drawalphamap8globe(x-TMP_MAP_BORDER, y-TMP_MAP_BORDER, GET_TILE_LIGHT_LEVEL(tile));
           }
         }
-        ptr++;
       }
     }
 
@@ -922,7 +971,107 @@ void MapWindow::updateLighting()
     }
 }
 
+/* Make a list of the locations around the view with a map tile that gives off
+ * light or is animated, or with an object that might give off light in one of
+ * its frames. The objects themselves are looked up when the light is drawn, so
+ * changing their frame doesn't make the list stale. ObjManager invalidates the
+ * list when objects are added, removed or moved.
+ */
+void MapWindow::buildLightList()
+{
+  unsigned char *map_ptr = map->get_map_data(cur_level);
+  uint16 pitch = map->get_width(cur_level);
+  uint16 x, y;
+
+  light_list.clear();
+  light_list_x = cur_x - TMP_MAP_BORDER - LIGHT_LIST_MARGIN;
+  light_list_y = cur_y - TMP_MAP_BORDER - LIGHT_LIST_MARGIN;
+  light_list_w = tmp_map_width + LIGHT_LIST_MARGIN * 2;
+  light_list_h = tmp_map_height + LIGHT_LIST_MARGIN * 2;
+  light_list_level = cur_level;
+
+  for(y=0;y<light_list_h;y++)
+  {
+    for(x=0;x<light_list_w;x++)
+    {
+      uint16 map_x = light_list_x + x, map_y = light_list_y + y;
+      WRAP_COORD(map_x, cur_level);
+      WRAP_COORD(map_y, cur_level);
+
+      LightSource l;
+      l.x = x;
+      l.y = y;
+      l.map_tile = false;
+      l.objs = false;
+
+      uint16 tile_num = map_ptr[map_y * pitch + map_x];
+      if(GET_TILE_LIGHT_LEVEL(tile_manager->get_tile(tile_num)) > 0
+         || tile_manager->get_tile_index(tile_num) != tile_num)
+        l.map_tile = true;
+
+      U6LList *obj_list = obj_manager->get_obj_list(map_x, map_y, cur_level);
+      if(obj_list)
+      {
+        for(U6Link *link=obj_list->start();link != NULL;link=link->next)
+        {
+          if(objMightGiveLight(((Obj *)link->data)->obj_n))
+          {
+            l.objs = true;
+            break;
+          }
+        }
+      }
+
+      if(l.map_tile || l.objs)
+        light_list.push_back(l);
+    }
+  }
+
+  light_list_valid = true;
+}
+
+/* Returns true if any frame of obj_n gives off light or is animated. Objects
+ * being lit or put out only change frame_n, so they stay in the light list.
+ */
+bool MapWindow::objMightGiveLight(uint16 obj_n)
+{
+ if(obj_light[obj_n] == 0)
+   {
+    uint16 first = obj_manager->get_obj_tile_num(obj_n);
+    uint16 last = first + 32; // more frames than any object has
+    if(obj_n < 1023 && obj_manager->get_obj_tile_num(obj_n + 1) > first)
+      last = obj_manager->get_obj_tile_num(obj_n + 1);
+    if(last > 2048)
+      last = 2048;
+
+    obj_light[obj_n] = 1;
+    for(uint16 tile_num = first; tile_num < last; tile_num++)
+      {
+       if(GET_TILE_LIGHT_LEVEL(tile_manager->get_tile(tile_num)) > 0
+          || tile_manager->get_tile_index(tile_num) != tile_num)
+         {
+          obj_light[obj_n] = 2;
+          break;
+         }
+      }
+   }
+
+ return obj_light[obj_n] == 2;
+}
+
+/* Recompute the blacking, forgetting every cached object boundary. This is
+ * called after objects may have been changed without ObjManager noticing.
+ */
 void MapWindow::updateBlacking()
+{
+ obj_boundary_valid = false;
+ refreshBlacking();
+}
+
+/* Recompute the blacking after the view moved. Object boundaries still cached
+ * from the last update are reused.
+ */
+void MapWindow::refreshBlacking()
 {
  generateTmpMap();
 
@@ -930,6 +1079,7 @@ void MapWindow::updateBlacking()
 
  m_ViewableObjects.clear();
 /// m_ViewableObjTiles.clear();
+ draw_list_valid = false;
 
  draw_brit_lens_anim = false;
  draw_garg_lens_anim = false;
@@ -939,52 +1089,18 @@ void MapWindow::updateBlacking()
 
 void MapWindow::Display(bool full_redraw)
 {
- uint16 i,j;
- uint16 *map_ptr;
-// uint16 map_width;
- Tile *tile;
- //unsigned char *ptr;
-
  if(lighting_update_required)
  {
    createLightOverlay();
+   full_redraw = true; // the light map is applied to every cell
  }
 
- //map_ptr = map->get_map_data(cur_level);
-// map_width = map->get_width(cur_level);
-
- //map_ptr += cur_y * map_width + cur_x;
-  map_ptr = tmp_map_buf;
-  map_ptr += (TMP_MAP_BORDER * tmp_map_width + TMP_MAP_BORDER);// * sizeof(uint16); //remember our tmp map is TMP_MAP_BORDER bigger all around.
-
-  for(i=0;i<win_height;i++)
-  {
-   for(j=0;j<win_width;j++)
-     {
-      sint16 draw_x = area.x + (j*16), draw_y = area.y + (i*16);
-      //draw_x -= (cur_x_add <= draw_x) ? cur_x_add : draw_x;
-      //draw_y -= (cur_y_add <= draw_y) ? cur_y_add : draw_y;
-      draw_x -= cur_x_add;
-      draw_y -= cur_y_add;
-      if(map_ptr[j] == 0)
-        screen->clear(draw_x,draw_y,16,16,&clip_rect); //blackout tile.
-      else
-        {
-         if(map_ptr[j] >= 16 && map_ptr[j] < 48) //lay down the base tile for shoreline tiles
-           {
-            tile = tile_manager->get_anim_base_tile(map_ptr[j]);
-            screen->blit(draw_x,draw_y,(unsigned char *)tile->data,8,16,16,16,tile->transparent,&clip_rect);
-           }
-
-         tile = tile_manager->get_tile(map_ptr[j]);
-         screen->blit(draw_x,draw_y,(unsigned char *)tile->data,8,16,16,16,tile->transparent,&clip_rect);
+ partial_redraw = false;
+ if(dirty_tiles)
+   partial_redraw = !updateCellSignatures(full_redraw || update_display);
+ update_display = false;
 
-        }
-
-     }
-   //map_ptr += map_width;
-   map_ptr += tmp_map_width ;//* sizeof(uint16);
-  }
+ drawMapTiles();
 
  drawObjs();
 
@@ -1003,19 +1119,25 @@ void MapWindow::Display(bool full_redraw)
 	drawGrid();
  }
 
- if(show_cursor)
+ if(show_cursor && drawCell(cursor_x, cursor_y))
   {
    screen->blit(area.x+cursor_x*16,area.y+cursor_y*16,(unsigned char *)cursor_tile->data,8,16,16,16,true,&clip_rect);
   }
 
- if(show_use_cursor)
+ if(show_use_cursor && drawCell(cursor_x, cursor_y))
   {
    screen->blit(area.x+cursor_x*16,area.y+cursor_y*16,(unsigned char *)use_tile->data,8,16,16,16,true,&clip_rect);
   }
 
 // screen->fill(0,8,8,win_height*16-16,win_height*16-16);
 
- screen->blitalphamap8(area.x, area.y, &clip_rect);
+ if(partial_redraw)
+  {
+   for(std::vector<SDL_Rect>::iterator r = dirty_areas.begin(); r != dirty_areas.end(); r++)
+     screen->blitalphamap8(area.x, area.y, &(*r));
+  }
+ else
+   screen->blitalphamap8(area.x, area.y, &clip_rect);
 
  if(game->get_clock()->get_timer(GAMECLOCK_TIMER_U6_INFRAVISION) != 0)
    drawActors();
@@ -1046,7 +1168,12 @@ void MapWindow::Display(bool full_redraw)
 
 // screen->blit(8,8,ptr,8,(win_width-1) * 16,(win_height-1) * 16, win_width * 16, false);
 
- if(game->is_orig_style())
+ if(partial_redraw)
+  {
+   for(std::vector<SDL_Rect>::iterator r = dirty_areas.begin(); r != dirty_areas.end(); r++)
+     screen->update((*r).x, (*r).y, (*r).w, (*r).h);
+  }
+ else if(game->is_orig_style())
 	 screen->update(area.x+8,area.y+8,win_width*16-16,win_height*16-16);
  else if(game->is_original_plus_cutoff_map())
 	 screen->update(Game::get_game()->get_game_x_offset(), Game::get_game()->get_game_y_offset(), game->get_game_width() - border_width - 1, game->get_game_height());
@@ -1061,6 +1188,269 @@ void MapWindow::Display(bool full_redraw)
 
 }
 
+/* Draw the base map tiles, or add them to the cell signatures. */
+void MapWindow::drawMapTiles()
+{
+ uint16 i,j;
+ uint16 *map_ptr;
+// uint16 map_width;
+ Tile *tile;
+
+ //map_ptr = map->get_map_data(cur_level);
+// map_width = map->get_width(cur_level);
+
+ //map_ptr += cur_y * map_width + cur_x;
+  map_ptr = tmp_map_buf;
+  map_ptr += (TMP_MAP_BORDER * tmp_map_width + TMP_MAP_BORDER);// * sizeof(uint16); //remember our tmp map is TMP_MAP_BORDER bigger all around.
+
+  for(i=0;i<win_height;i++)
+  {
+   for(j=0;j<win_width;j++)
+     {
+      if(signing)
+        {
+         if(map_ptr[j] == 0)
+           signCell(j, i, 0);
+         else
+           {
+            if(map_ptr[j] >= 16 && map_ptr[j] < 48)
+              signTile(tile_manager->get_anim_base_tile(map_ptr[j]), j, i);
+            signTile(tile_manager->get_tile(map_ptr[j]), j, i);
+           }
+         continue;
+        }
+      if(!drawCell(j, i))
+        continue;
+
+      sint16 draw_x = area.x + (j*16), draw_y = area.y + (i*16);
+      //draw_x -= (cur_x_add <= draw_x) ? cur_x_add : draw_x;
+      //draw_y -= (cur_y_add <= draw_y) ? cur_y_add : draw_y;
+      draw_x -= cur_x_add;
+      draw_y -= cur_y_add;
+      if(map_ptr[j] == 0)
+        screen->clear(draw_x,draw_y,16,16,&clip_rect); //blackout tile.
+      else
+        {
+         if(map_ptr[j] >= 16 && map_ptr[j] < 48) //lay down the base tile for shoreline tiles
+           {
+            tile = tile_manager->get_anim_base_tile(map_ptr[j]);
+            screen->blit(draw_x,draw_y,(unsigned char *)tile->data,8,16,16,16,tile->transparent,&clip_rect);
+           }
+
+         tile = tile_manager->get_tile(map_ptr[j]);
+         screen->blit(draw_x,draw_y,(unsigned char *)tile->data,8,16,16,16,tile->transparent,&clip_rect);
+
+        }
+
+     }
+   //map_ptr += map_width;
+   map_ptr += tmp_map_width ;//* sizeof(uint16);
+  }
+}
+
+/* Returns true if window cell x,y should be drawn. All cells are drawn unless
+ * this is a partial redraw.
+ */
+bool MapWindow::drawCell(uint16 x, uint16 y)
+{
+ if(!partial_redraw)
+   return true;
+ return(x < win_width && y < win_height && cell_dirty[y * win_width + x]);
+}
+
+/* Add something drawn in window cell x,y to the cell's signature. */
+inline void MapWindow::signCell(uint16 x, uint16 y, uint32 value)
+{
+ if(x >= win_width || y >= win_height)
+   return;
+ uint32 &sig = cell_sig[y * win_width + x];
+ sig = (sig ^ value) * 16777619;
+}
+
+/* Add a tile drawn in window cell x,y to the cell's signature. Tiles from
+ * TileManager are signed by address. Tiles made just for this frame are
+ * signed by their pixels.
+ */
+void MapWindow::signTile(const Tile *tile, uint16 x, uint16 y, bool use_tile_data)
+{
+ if(use_tile_data)
+   {
+    for(int i=0;i<256;i++)
+      signCell(x, y, tile->data[i]);
+   }
+ else
+   {
+    uintptr_t addr = (uintptr_t)tile;
+    signCell(x, y, (uint32)addr ^ (uint32)((unsigned long long)addr >> 32));
+   }
+
+ // cycled colours change every time the palette rotates, unless the screen
+ // can redraw them from its index buffer
+ if(sign_cycled_colours && !use_tile_data && tileHasCycledColours(tile))
+   signCell(x, y, screen->get_palette_revision());
+}
+
+/* Returns true if the tile uses any palette entries that GamePalette cycles. */
+bool MapWindow::tileHasCycledColours(const Tile *tile)
+{
+ std::unordered_map<const Tile *, bool>::iterator t = cycled_colour_tiles.find(tile);
+ if(t != cycled_colour_tiles.end())
+   return t->second;
+
+ bool cycled = false;
+ for(int i=0;i<256 && !cycled;i++)
+   cycled = (tile->data[i] >= 0xe0 && tile->data[i] != 0xff);
+ cycled_colour_tiles[tile] = cycled;
+ return cycled;
+}
+
+static bool areas_overlap(const SDL_Rect &a, const SDL_Rect &b)
+{
+ return(a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h);
+}
+
+/* Work out what is drawn in each cell of the window this frame, and mark the
+ * cells that differ from the last frame, or are under widgets drawn over the
+ * window, as dirty. Returns true if the whole window has to be redrawn
+ * instead, because it scrolled, something is drawn across cells, or other
+ * widgets changed.
+ */
+bool MapWindow::updateCellSignatures(bool full_redraw)
+{
+ uint32 count = win_width * win_height;
+ if(cell_count != count)
+   {
+    cell_sig = (uint32 *)nuvie_realloc(cell_sig, count * sizeof(uint32));
+    last_cell_sig = (uint32 *)nuvie_realloc(last_cell_sig, count * sizeof(uint32));
+    cell_dirty = (uint8 *)nuvie_realloc(cell_dirty, count);
+    cell_count = count;
+    full_redraw = true;
+   }
+
+ uint32 *sig = last_cell_sig;
+ last_cell_sig = cell_sig;
+ cell_sig = sig;
+ for(uint32 i=0;i<count;i++)
+   cell_sig[i] = 2166136261U;
+
+ sign_cycled_colours = (!screen->is_indexed()
+                        || (screen->get_lighting_style() == LIGHTING_STYLE_SMOOTH && screen->get_ambient() != 0xff));
+
+ signing = true;
+ drawMapTiles();
+ drawObjs();
+ if(roof_mode && roof_display != ROOF_DISPLAY_OFF)
+   drawRoofs();
+ if(show_grid)
+   drawGrid();
+ if(show_cursor)
+   signTile(cursor_tile, cursor_x, cursor_y);
+ if(show_use_cursor)
+   signTile(use_tile, cursor_x, cursor_y);
+ signing = false;
+
+ GameClock *clock = game->get_clock();
+ MapWindowView view;
+ view.x = cur_x;
+ view.y = cur_y;
+ view.level = cur_level;
+ view.x_add = cur_x_add;
+ view.y_add = cur_y_add;
+ view.area = area;
+ view.effects = (anim_manager->has_anims() || overlay != NULL || is_wizard_eye_mode()
+                 || clock->get_timer(GAMECLOCK_TIMER_U6_STORM) != 0
+                 || clock->get_timer(GAMECLOCK_TIMER_U6_INFRAVISION) != 0);
+
+ if(view.x != last_view.x || view.y != last_view.y || view.level != last_view.level
+    || view.x_add != 0 || view.y_add != 0 || last_view.x_add != 0 || last_view.y_add != 0
+    || view.area.x != last_view.area.x || view.area.y != last_view.area.y
+    || view.area.w != last_view.area.w || view.area.h != last_view.area.h
+    || view.effects || last_view.effects)
+   full_redraw = true;
+ last_view = view;
+
+ // widgets drawn before this one may have drawn over it
+ const std::vector<SDL_Rect> &redrawn = GUI::get_gui()->get_redrawn_areas();
+ for(std::vector<SDL_Rect>::const_iterator r = redrawn.begin(); r != redrawn.end(); r++)
+   {
+    if(areas_overlap(*r, clip_rect))
+      full_redraw = true;
+   }
+
+ // widgets drawn after this one cover it, so cells under them are redrawn
+ // every frame, and everything is redrawn if they move
+ std::vector<SDL_Rect> areas;
+ GUI::get_gui()->get_areas_above(this, areas);
+ for(std::vector<SDL_Rect>::iterator r = areas.begin(); r != areas.end(); )
+   {
+    if(areas_overlap(*r, clip_rect))
+      r++;
+    else
+      r = areas.erase(r);
+   }
+ if(areas.size() != covered_areas.size())
+   full_redraw = true;
+ else
+   {
+    for(uint32 i=0;i<areas.size();i++)
+      {
+       if(areas[i].x != covered_areas[i].x || areas[i].y != covered_areas[i].y
+          || areas[i].w != covered_areas[i].w || areas[i].h != covered_areas[i].h)
+         full_redraw = true;
+      }
+   }
+ covered_areas.swap(areas);
+
+ dirty_areas.clear();
+ if(full_redraw)
+   return true;
+
+ for(uint32 i=0;i<count;i++)
+   cell_dirty[i] = (cell_sig[i] != last_cell_sig[i]);
+
+ for(std::vector<SDL_Rect>::iterator r = covered_areas.begin(); r != covered_areas.end(); r++)
+   {
+    for(uint16 y=0;y<win_height;y++)
+      {
+       for(uint16 x=0;x<win_width;x++)
+         {
+          SDL_Rect cell = { (sint16)(area.x + x*16), (sint16)(area.y + y*16), 16, 16 };
+          if(areas_overlap(*r, cell))
+            cell_dirty[y * win_width + x] = 1;
+         }
+      }
+   }
+
+ // join the dirty cells on each row into runs, clipped to the window
+ for(uint16 y=0;y<win_height;y++)
+   {
+    uint8 *row = &cell_dirty[y * win_width];
+    for(uint16 x=0;x<win_width;)
+      {
+       if(!row[x])
+         {
+          x++;
+          continue;
+         }
+       uint16 run_x = x;
+       while(x < win_width && row[x])
+         x++;
+
+       sint32 x1 = MAX(area.x + run_x*16, clip_rect.x);
+       sint32 y1 = MAX(area.y + y*16, clip_rect.y);
+       sint32 x2 = MIN(area.x + x*16, clip_rect.x + clip_rect.w);
+       sint32 y2 = MIN(area.y + (y+1)*16, clip_rect.y + clip_rect.h);
+       if(x2 > x1 && y2 > y1)
+         {
+          SDL_Rect run = { (sint16)x1, (sint16)y1, (uint16)(x2 - x1), (uint16)(y2 - y1) };
+          dirty_areas.push_back(run);
+         }
+      }
+   }
+
+ return false;
+}
+
 void MapWindow::drawActors()
 {
  uint16 i;
@@ -1154,7 +1544,8 @@ inline void MapWindow::drawActor(Actor *actor)
 
 void MapWindow::drawObjs()
 {
- //FIX we need to make this more efficent.
+ if(!draw_list_valid || drawListIsStale())
+   buildDrawList();
 
  drawObjSuperBlock(true,false); //draw force lower objects
  drawObjSuperBlock(false,false); //draw lower objects
@@ -1188,7 +1579,11 @@ inline void MapWindow::drawLensAnim()
 	}
 }
 
-void MapWindow::drawObjSuperBlock(bool draw_lowertiles, bool toptile)
+/* Make a list of the objects in view, in the order they are drawn, and note
+ * which of them can be seen. Objects are drawn from the bottom right corner of
+ * the window to the top left.
+ */
+void MapWindow::buildDrawList()
 {
  U6Link *link;
  U6LList *obj_list;
@@ -1196,6 +1591,8 @@ void MapWindow::drawObjSuperBlock(bool draw_lowertiles, bool toptile)
  sint16 x,y;
  uint16 stop_x, stop_y;
 
+ draw_list.clear();
+
  if(cur_x < 0)
    stop_x = 0;
  else
@@ -1216,68 +1613,87 @@ void MapWindow::drawObjSuperBlock(bool draw_lowertiles, bool toptile)
             for(link=obj_list->start();link != NULL;link=link->next)
               {
                obj = (Obj *)link->data;
-               drawObj(obj, draw_lowertiles, toptile);
+               sint16 win_x = WRAP_VIEWP(cur_x, obj->x, map_width);
+               sint16 win_y = obj->y - cur_y;
+               if(win_x < 0 || win_y < 0)
+                 continue;
+
+               if(window_updated)
+               {
+                 m_ViewableObjects.push_back(obj);
+
+                 if(game_type == NUVIE_GAME_U6 && cur_level == 0 && obj->y == 0x353 && tmp_map_buf[(win_y+TMP_MAP_BORDER)*tmp_map_width+(win_x+TMP_MAP_BORDER)] != 0)
+                 {
+                   if(obj->obj_n == 394 && obj->x == 0x399)
+                     draw_brit_lens_anim = true;
+                   else if(obj->obj_n == 396 && obj->x == 0x39d)
+                     draw_garg_lens_anim = true;
+                 }
+               }
+
+               DrawListObj d;
+               d.obj = obj;
+               d.tile = tile_manager->get_original_tile(obj_manager->get_obj_tile_num(obj)+obj->frame_n);
+               d.x = win_x;
+               d.y = win_y;
+               d.obj_n = obj->obj_n;
+               d.frame_n = obj->frame_n;
+               d.status = obj->status;
+               d.force_lower = (d.tile->flags3 & 0x4);
+               d.visible = true;
+
+               //don't show invisible objects.
+               if(obj->status & OBJ_STATUS_INVISIBLE)
+                 d.visible = false;
+               else if(tmp_map_buf[(win_y+TMP_MAP_BORDER)*tmp_map_width+(win_x+TMP_MAP_BORDER)] == 0) //don't draw object if area is in darkness.
+                 d.visible = false;
+               // We don't show objects on walls if the area to the right or bottom of the wall is in darkness
+               else if(tmp_map_buf[(win_y+TMP_MAP_BORDER)*tmp_map_width+(win_x+TMP_MAP_BORDER+1)] == 0 || tmp_map_buf[(win_y+TMP_MAP_BORDER+1)*tmp_map_width+(win_x+TMP_MAP_BORDER)] == 0)
+               {
+                 if((!(d.tile->flags1 & TILEFLAG_WALL) || (game_type == NUVIE_GAME_U6 && obj->obj_n == OBJ_U6_BARS)))
+                   d.visible = false;
+               }
+
+               draw_list.push_back(d);
               }
            }
          }
       }
 
+ draw_list_valid = true;
 }
 
-inline void MapWindow::drawObj(Obj *obj, bool draw_lowertiles, bool toptile)
+/* Returns true if an object in the draw list was changed without ObjManager
+ * being told, so the list has to be made again.
+ */
+bool MapWindow::drawListIsStale()
 {
- sint16 x,y;
- Tile *tile;
-
- y = obj->y - cur_y;
- x = WRAP_VIEWP(cur_x, obj->x, map_width);
-
- if(x < 0 || y < 0)
-   return;
-
- if(window_updated)
- {
-   m_ViewableObjects.push_back(obj);
-
-   if(game_type == NUVIE_GAME_U6 && cur_level == 0 && obj->y == 0x353 && tmp_map_buf[(y+TMP_MAP_BORDER)*tmp_map_width+(x+TMP_MAP_BORDER)] != 0)
+ for(std::vector<DrawListObj>::iterator d = draw_list.begin(); d != draw_list.end(); d++)
    {
-	   if(obj->obj_n == 394 && obj->x == 0x399)
-	   {
-		   draw_brit_lens_anim = true;
-	   }
-	   else if(obj->obj_n == 396 && obj->x == 0x39d)
-	   {
-		   draw_garg_lens_anim = true;
-	   }
+    if((*d).obj->obj_n != (*d).obj_n || (*d).obj->frame_n != (*d).frame_n || (*d).obj->status != (*d).status)
+      return true;
    }
- }
-
- //don't show invisible objects. 
- if(obj->status & OBJ_STATUS_INVISIBLE)
-    return;
+ return false;
+}
 
- tile = tile_manager->get_original_tile(obj_manager->get_obj_tile_num(obj)+obj->frame_n);
+/* Draw force lower objects, lower objects, or the top tiles of all objects
+ * from the draw list.
+ */
+void MapWindow::drawObjSuperBlock(bool draw_lowertiles, bool toptile)
+{
+ for(std::vector<DrawListObj>::iterator d = draw_list.begin(); d != draw_list.end(); d++)
+   {
+    if(!(*d).visible)
+      continue;
 
- if(draw_lowertiles == false && (tile->flags3 & 0x4) && toptile == false) //don't display force lower tiles.
-   return;
+    if(draw_lowertiles == false && (*d).force_lower && toptile == false) //don't display force lower tiles.
+      continue;
 
- if(draw_lowertiles == true && !(tile->flags3 & 0x4))
-   return;
-
- if(tmp_map_buf[(y+TMP_MAP_BORDER)*tmp_map_width+(x+TMP_MAP_BORDER)] == 0) //don't draw object if area is in darkness.
-    return;
- else
-    {
-     // We don't show objects on walls if the area to the right or bottom of the wall is in darkness
-     if(tmp_map_buf[(y+TMP_MAP_BORDER)*tmp_map_width+(x+TMP_MAP_BORDER+1)] == 0 || tmp_map_buf[(y+TMP_MAP_BORDER+1)*tmp_map_width+(x+TMP_MAP_BORDER)] == 0)
-     {
-      if((!(tile->flags1 & TILEFLAG_WALL) || (game_type == NUVIE_GAME_U6 && obj->obj_n == OBJ_U6_BARS)))
-        return;
-     }
-    }
-
-  drawTile(tile, x, obj->y - cur_y, toptile);
+    if(draw_lowertiles == true && !(*d).force_lower)
+      continue;
 
+    drawTile((*d).tile, (*d).x, (*d).y, toptile);
+   }
 }
 
 /* The pixeldata in the passed Tile pointer will be used if use_tile_data is
@@ -1312,7 +1728,7 @@ inline void MapWindow::drawTile(Tile *tile, uint16 x, uint16 y, bool toptile,
  dbl_height = tile->dbl_height;
 
  if(x < win_width && y < win_height)
-   drawTopTile(use_tile_data?tile:tile_manager->get_tile(tile_num),x,y,toptile);
+   drawTopTile(use_tile_data?tile:tile_manager->get_tile(tile_num),x,y,toptile,use_tile_data);
 
  if(dbl_width)
    {
@@ -1348,7 +1764,7 @@ inline void MapWindow::drawNewTile(Tile *tile, uint16 x, uint16 y, bool toptile)
     drawTile(tile, x,y, toptile, true);
 }
 
-inline void MapWindow::drawTopTile(Tile *tile, uint16 x, uint16 y, bool toptile)
+inline void MapWindow::drawTopTile(Tile *tile, uint16 x, uint16 y, bool toptile, bool use_tile_data)
 {
 
 
@@ -1358,18 +1774,14 @@ inline void MapWindow::drawTopTile(Tile *tile, uint16 x, uint16 y, bool toptile)
 //    screen->blit(cursor_tile->data,8,x*16,y*16,16,16,false);
 //   }
 // FIXME: Don't use pixel offset (x_add,y_add) here, pass it via params?
- if(toptile)
-    {
-     if(tile->toptile)
-//        screen->blit(x*16,y*16,tile->data,8,16,16,16,tile->transparent,&clip_rect);
-        screen->blit(area.x+(x*16)-cur_x_add,area.y+(y*16)-cur_y_add,tile->data,8,16,16,16,tile->transparent,&clip_rect);
-    }
- else
-    {
-     if(!tile->toptile)
-//        screen->blit(x*16,y*16,tile->data,8,16,16,16,tile->transparent,&clip_rect);
-        screen->blit(area.x+(x*16)-cur_x_add,area.y+(y*16)-cur_y_add,tile->data,8,16,16,16,tile->transparent,&clip_rect);
-    }
+ if(tile->toptile != toptile)
+    return;
+
+ if(signing)
+    signTile(tile, x, y, use_tile_data);
+ else if(drawCell(x, y))
+//    screen->blit(x*16,y*16,tile->data,8,16,16,16,tile->transparent,&clip_rect);
+    screen->blit_tile(area.x+(x*16)-cur_x_add,area.y+(y*16)-cur_y_add,tile,tile_manager->get_native_tile(tile),&clip_rect);
 }
 
 void MapWindow::drawBorder()
@@ -1442,7 +1854,9 @@ void MapWindow::drawRoofs()
 	  {
 	   for(uint16 j=0;j<win_width;j++)
 	     {
-		   if(roof_map_ptr[j] != 0)
+		   if(roof_map_ptr[j] != 0 && signing)
+		     signCell(j, i, MAPWINDOW_ROOF_SIGNATURE | roof_map_ptr[j]);
+		   else if(roof_map_ptr[j] != 0 && drawCell(j, i))
 		   {
 	      dst.x = area.x + (j*16);
 	      dst.y = area.y + (i*16);
@@ -1549,7 +1963,10 @@ void MapWindow::drawGrid()
 	  {
 	   for(uint16 j=0;j<win_width;j++)
 	     {
-		   screen->blit(area.x + (j*16) - cur_x_add, area.y + (i*16) - cur_y_add, (unsigned char *)grid_tile.data, 8, 16, 16, 16, true);
+		   if(signing)
+		     signTile(&grid_tile, j, i);
+		   else if(drawCell(j, i))
+		     screen->blit(area.x + (j*16) - cur_x_add, area.y + (i*16) - cur_y_add, (unsigned char *)grid_tile.data, 8, 16, 16, 16, true);
 	     }
 	  }
 }
@@ -1614,6 +2031,7 @@ void MapWindow::generateTmpMap()
      y = WRAPPED_COORD(y + 1, cur_level);
   }
  last_boundary_fill_x = x; last_boundary_fill_y = y;
+ updateObjBoundaryCache();
  boundaryFill(map_ptr, pitch, x, y);
 
  reshapeBoundary();
@@ -1622,77 +2040,167 @@ void MapWindow::generateTmpMap()
 	roof_display = ROOF_DISPLAY_OFF; // hide roof if a building's floor is showing.
 }
 
-void MapWindow::boundaryFill(unsigned char *map_ptr, uint16 pitch, uint16 x, uint16 y)
+/* Line up the object boundary cache with the current view. Cached locations
+ * still in view are kept when the view has moved, and the rest are marked
+ * unknown. Everything is forgotten on a level change or when animated tiles
+ * may have changed which objects are boundaries.
+ */
+void MapWindow::updateObjBoundaryCache()
 {
- unsigned char current;
- uint16 *ptr;
- uint16 pos;
- uint16 tmp_x, tmp_y;
- uint16 p_cur_x, p_cur_y; //wrapped cur_x - 1 and wrapped cur_y - 1
- 
- p_cur_x = WRAPPED_COORD(cur_x - TMP_MAP_BORDER,cur_level);
- p_cur_y = WRAPPED_COORD(cur_y - TMP_MAP_BORDER,cur_level);
-	
- if(x == WRAPPED_COORD(p_cur_x - 1, cur_level) || x == WRAPPED_COORD(p_cur_x + tmp_map_width, cur_level))
-   return;
+ uint16 x = WRAPPED_COORD(cur_x - TMP_MAP_BORDER, cur_level);
+ uint16 y = WRAPPED_COORD(cur_y - TMP_MAP_BORDER, cur_level);
+ uint32 tile_revision = tile_manager->get_passable_revision();
+ sint32 dx = 0, dy = 0;
 
- if(y == WRAPPED_COORD(p_cur_y - 1, cur_level) || y == WRAPPED_COORD(p_cur_y + tmp_map_height, cur_level))
-   return;
- 
- if(p_cur_y > y)
-	 tmp_y = pitch - p_cur_y + y;
+ if(obj_boundary_valid && obj_boundary_level == cur_level
+    && obj_boundary_tile_revision == tile_revision)
+  {
+   sint32 side = MAP_SIDE_LENGTH(cur_level);
+   dx = (sint32)x - obj_boundary_x;
+   dy = (sint32)y - obj_boundary_y;
+   // take the short way around the edge of the map
+   if(dx > side / 2) dx -= side;
+   if(dx < -side / 2) dx += side;
+   if(dy > side / 2) dy -= side;
+   if(dy < -side / 2) dy += side;
+   if(abs(dx) >= tmp_map_width || abs(dy) >= tmp_map_height)
+     obj_boundary_valid = false;
+  }
  else
-	 tmp_y = y - p_cur_y;
- 
- pos = tmp_y * tmp_map_width;
+   obj_boundary_valid = false;
 
-  if (p_cur_x > x)
-    tmp_x = pitch - p_cur_x + x;
-  else
-    tmp_x = x - p_cur_x;
+ if(!obj_boundary_valid)
+   memset(tmp_map_obj_boundary, 0, tmp_map_width * tmp_map_height);
+ else if(dx != 0 || dy != 0)
+  {
+   // move the cached rows and columns that are still in view into place
+   uint16 w = tmp_map_width - abs(dx);
+   uint16 src_x = dx > 0 ? dx : 0;
+   uint16 dst_x = dx > 0 ? 0 : -dx;
+   for(sint32 i = 0; i < tmp_map_height; i++)
+     {
+      sint32 row = dy > 0 ? i : tmp_map_height - 1 - i; // don't overwrite rows before moving them
+      sint32 src_row = row + dy;
+      uint8 *dst = &tmp_map_obj_boundary[row * tmp_map_width];
+      if(src_row < 0 || src_row >= tmp_map_height)
+        {
+         memset(dst, 0, tmp_map_width);
+         continue;
+        }
+      memmove(dst + dst_x, &tmp_map_obj_boundary[src_row * tmp_map_width + src_x], w);
+      memset(dx > 0 ? dst + w : dst, 0, tmp_map_width - w);
+     }
+  }
 
-  pos += tmp_x;
+ obj_boundary_x = x;
+ obj_boundary_y = y;
+ obj_boundary_level = cur_level;
+ obj_boundary_tile_revision = tile_revision;
+ obj_boundary_valid = true;
+}
 
- ptr = &tmp_map_buf[pos];
+/* Objects at x,y have changed. Forget the draw list and the cached object
+ * boundaries they can affect. Double width and height objects also cover the
+ * locations to the west and north.
+ */
+void MapWindow::invalidate_obj_cache(uint16 x, uint16 y, uint8 level)
+{
+ if(level == cur_level)
+   draw_list_valid = false;
 
- if(*ptr != 0)
+ if(light_list_valid && level == light_list_level)
+   {
+    uint16 side = MAP_SIDE_LENGTH(level);
+    uint16 list_x = (WRAPPED_COORD(x, level) + side - WRAPPED_COORD(light_list_x, level)) % side;
+    uint16 list_y = (WRAPPED_COORD(y, level) + side - WRAPPED_COORD(light_list_y, level)) % side;
+    if(list_x < light_list_w && list_y < light_list_h)
+      light_list_valid = false;
+   }
+
+ if(!obj_boundary_valid || level != obj_boundary_level || tmp_map_obj_boundary == NULL)
    return;
 
- current = map_ptr[y * pitch + x];
+ uint16 side = MAP_SIDE_LENGTH(level);
+ uint16 tmp_x = (WRAPPED_COORD(x, level) + side - obj_boundary_x) % side;
+ uint16 tmp_y = (WRAPPED_COORD(y, level) + side - obj_boundary_y) % side;
 
- *ptr = (uint16)current;
+ for(uint16 j = 0; j < 2; j++)
+   for(uint16 i = 0; i < 2; i++)
+     {
+      // tmp_x - 1 wraps to a large value when tmp_x is 0
+      uint16 cx = (tmp_x + side - i) % side, cy = (tmp_y + side - j) % side;
+      if(cx < tmp_map_width && cy < tmp_map_height)
+        tmp_map_obj_boundary[cy * tmp_map_width + cx] = 0;
+     }
+}
 
-  AddMapTileToVisibleList(current, tmp_x, tmp_y);
+/* Returns true if objects at tmp map location x,y form a boundary. The result
+ * is cached until the location is invalidated or scrolls out of view.
+ */
+bool MapWindow::tmpBufObjIsBoundary(uint16 x, uint16 y)
+{
+ uint8 &cached = tmp_map_obj_boundary[y * tmp_map_width + x];
 
- if(x_ray_view <= X_RAY_OFF && map->is_boundary(x,y,cur_level)) //hit the boundary wall tiles
-  {
-   if(boundaryLookThroughWindow(*ptr, x, y) == false)
-      return;
-   else
-	   roof_display = ROOF_DISPLAY_OFF; //hide roof tiles if player is looking through window.
-  }
+ if(cached == 0)
+   cached = obj_manager->is_boundary(WRAPPED_COORD(obj_boundary_x + x, cur_level),
+                                     WRAPPED_COORD(obj_boundary_y + y, cur_level), cur_level) ? 2 : 1;
+ return(cached == 2);
+}
 
+/* Flood fill the tmp map from x,y, stopping at boundaries. This visits
+ * locations in the same order as filling each neighbor recursively would, but
+ * keeps its own stack so large windows can't overflow the call stack.
+ */
+void MapWindow::boundaryFill(unsigned char *map_ptr, uint16 pitch, uint16 x, uint16 y)
+{
+ static const sint8 neighbors[8][2] = { {1,0}, {0,1}, {1,1}, {-1,-1}, {-1,0}, {0,-1}, {1,-1}, {-1,1} };
+ uint16 p_cur_x, p_cur_y; //wrapped cur_x - TMP_MAP_BORDER and wrapped cur_y - TMP_MAP_BORDER
 
- uint16 xp1,xm1;
- uint16 yp1,ym1;
- 
- xp1 = WRAPPED_COORD(x+1,cur_level);
- xm1 = WRAPPED_COORD(x-1,cur_level);
+ p_cur_x = WRAPPED_COORD(cur_x - TMP_MAP_BORDER,cur_level);
+ p_cur_y = WRAPPED_COORD(cur_y - TMP_MAP_BORDER,cur_level);
 
- yp1 = WRAPPED_COORD(y+1,cur_level);
- ym1 = WRAPPED_COORD(y-1,cur_level);
- 
- boundaryFill(map_ptr, pitch, xp1,   y);
- boundaryFill(map_ptr, pitch,   x, yp1);
- boundaryFill(map_ptr, pitch, xp1, yp1);
- boundaryFill(map_ptr, pitch, xm1, ym1);
- boundaryFill(map_ptr, pitch, xm1,   y);
- boundaryFill(map_ptr, pitch,   x, ym1);
- boundaryFill(map_ptr, pitch, xp1, ym1);
- boundaryFill(map_ptr, pitch, xm1, yp1);
+ fill_stack.clear();
+ fill_stack.push_back(std::make_pair((sint16)((x + pitch - p_cur_x) % pitch),
+                                     (sint16)((y + pitch - p_cur_y) % pitch)));
 
+ while(!fill_stack.empty())
+   {
+    sint16 tmp_x = fill_stack.back().first;
+    sint16 tmp_y = fill_stack.back().second;
+    fill_stack.pop_back();
 
- return;
+    if(tmp_x < 0 || tmp_x >= tmp_map_width || tmp_y < 0 || tmp_y >= tmp_map_height)
+      continue;
+
+    uint16 *ptr = &tmp_map_buf[tmp_y * tmp_map_width + tmp_x];
+    if(*ptr != 0)
+      continue;
+
+    x = WRAPPED_COORD(p_cur_x + tmp_x, cur_level);
+    y = WRAPPED_COORD(p_cur_y + tmp_y, cur_level);
+    unsigned char current = map_ptr[y * pitch + x];
+
+    *ptr = (uint16)current;
+
+    AddMapTileToVisibleList(current, tmp_x, tmp_y);
+
+    if(x_ray_view <= X_RAY_OFF) //hit the boundary wall tiles
+      {
+       Tile *map_tile = tile_manager->get_tile(current);
+       if((map_tile->boundary && obj_manager->is_forced_passable(x, y, cur_level) == false)
+          || tmpBufObjIsBoundary(tmp_x, tmp_y))
+         {
+          if(boundaryLookThroughWindow(*ptr, x, y) == false)
+            continue;
+          else
+            roof_display = ROOF_DISPLAY_OFF; //hide roof tiles if player is looking through window.
+         }
+      }
+
+    // push in reverse so the first neighbor is visited first
+    for(sint8 i = 7; i >= 0; i--)
+      fill_stack.push_back(std::make_pair((sint16)(tmp_x + neighbors[i][0]), (sint16)(tmp_y + neighbors[i][1])));
+   }
 }
 
 bool MapWindow::floorTilesVisible()
@@ -1885,7 +2393,7 @@ bool MapWindow::tmpBufTileIsBoundary(uint16 x, uint16 y)
  if(tile->boundary)
    return true;
 
- if(obj_manager->is_boundary(WRAPPED_COORD(cur_x-TMP_MAP_BORDER+x, cur_level), WRAPPED_COORD(cur_y-TMP_MAP_BORDER+y, cur_level), cur_level))
+ if(tmpBufObjIsBoundary(x, y))
    return true;
 
  return false;
@@ -2675,7 +3183,7 @@ void MapWindow::drag_draw(int x, int y, int message, void* data)
 /* Display MapWindow animations. */
 void MapWindow::drawAnims(bool top_anims)
 {
-    if(!screen) // screen should be set early on
+    if(!screen || signing) // screen should be set early on
         return;
     else if(!anim_manager->get_surface()) // screen must be assigned to AnimManager
         anim_manager->set_surface(screen);
@@ -25,6 +25,7 @@
  */
 
 #include <vector>
+#include <unordered_map>
 #include "SDL.h"
 
 #include "nuvieDefs.h"
@@ -57,6 +58,33 @@ typedef struct {
 	uint16 x,y;
 } TileInfo;
 
+typedef struct {
+	Obj *obj;
+	Tile *tile; // original tile, for its flags
+	uint16 x,y; // location in the window
+	uint16 obj_n; // object as it was when added to the draw list
+	uint8 frame_n;
+	uint8 status;
+	bool visible;
+	bool force_lower;
+} DrawListObj;
+
+#define LIGHT_LIST_MARGIN 8 // locations kept in the light list on each side of the area around the view
+
+typedef struct {
+	uint16 x,y; // location from light_list_x, light_list_y
+	bool map_tile; // the map tile gives off light or is animated
+	bool objs; // an object here might give off light
+} LightSource;
+
+typedef struct {
+	sint16 x, y; // cur_x, cur_y
+	uint8 level;
+	uint8 x_add, y_add;
+	SDL_Rect area;
+	bool effects; // anims, rain, overlays, infravision or the wizard eye are drawn
+} MapWindowView;
+
 typedef struct {
 	Tile *eye_tile;
 	uint16 prev_x, prev_y;
@@ -88,6 +116,20 @@ class MapWindow: public GUI_Widget
 
  uint16 *tmp_map_buf; // tempory buffer for flood fill, hide rooms.
  uint16 tmp_map_width, tmp_map_height;
+ uint8 *tmp_map_obj_boundary; // cached ObjManager::is_boundary() for each tmp_map_buf location
+ uint16 obj_boundary_x, obj_boundary_y; // map location of tmp_map_obj_boundary[0]
+ uint8 obj_boundary_level;
+ uint32 obj_boundary_tile_revision; // TileManager passable revision the cache was made with
+ bool obj_boundary_valid;
+ std::vector<std::pair<sint16, sint16> > fill_stack; // boundaryFill() locations to visit
+ std::vector<DrawListObj> draw_list; // objects in view, in the order drawObjSuperBlock() paints them
+ bool draw_list_valid;
+ std::vector<LightSource> light_list; // locations around the view with map tiles or objects that might give off light
+ sint32 light_list_x, light_list_y; // map location the light list starts at, not wrapped
+ uint16 light_list_w, light_list_h;
+ uint8 light_list_level;
+ bool light_list_valid;
+ uint8 obj_light[1024]; // for each obj_n, 0 if not known yet, 1 if no frame gives off light, 2 if one might
  SDL_Surface *overlay; // used for visual effects
  uint8 overlay_level; // where the overlay surface is placed
  int min_brightness;
@@ -146,6 +188,19 @@ class MapWindow: public GUI_Widget
 
  bool lighting_update_required;
 
+ bool dirty_tiles; // only redraw cells that changed since the last frame
+ bool signing; // draw functions add to cell_sig instead of drawing
+ bool partial_redraw; // draw functions skip cells that aren't in cell_dirty
+ uint32 *cell_sig; // hash of what was drawn in each window cell this frame
+ uint32 *last_cell_sig; // cell_sig from the last frame
+ uint8 *cell_dirty; // cells to draw in a partial redraw
+ std::vector<SDL_Rect> dirty_areas; // runs of dirty cells on each row, clipped to the window
+ uint32 cell_count; // size of the cell buffers
+ MapWindowView last_view; // view the last frame was drawn with
+ std::vector<SDL_Rect> covered_areas; // areas of widgets drawn over the window in the last frame
+ std::unordered_map<const Tile *, bool> cycled_colour_tiles; // tiles that use colours from cycled palette entries
+ bool sign_cycled_colours; // cells with cycled colours change with the palette
+
  public:
 
  MapWindow(Configuration *cfg, Map *m);
@@ -234,6 +289,8 @@ class MapWindow: public GUI_Widget
 
  void updateBlacking();
  void updateAmbience();
+ void invalidate_obj_cache(uint16 x, uint16 y, uint8 level);
+ void invalidate_obj_cache() { obj_boundary_valid = false; draw_list_valid = false; light_list_valid = false; }
  void update();
  void Display(bool full_redraw);
 
@@ -281,20 +338,32 @@ protected:
  void drawActors();
  void drawAnims(bool top_anims);
  void drawObjs();
+ void buildDrawList();
+ bool drawListIsStale();
  void drawObjSuperBlock(bool draw_lowertiles, bool toptile);
- inline void drawObj(Obj *obj, bool draw_lowertiles, bool toptile);
  inline void drawTile(Tile *tile, uint16 x, uint16 y, bool toptile, bool use_tile_data=false);
  inline void drawNewTile(Tile *tile, uint16 x, uint16 y, bool toptile);
  void drawBorder();
- inline void drawTopTile(Tile *tile, uint16 x, uint16 y, bool toptile);
+ inline void drawTopTile(Tile *tile, uint16 x, uint16 y, bool toptile, bool use_tile_data=false);
  inline void drawActor(Actor *actor);
  void drawRoofs();
  void drawGrid();
  void drawRain();
  inline void drawLensAnim();
+ void drawMapTiles();
+ bool drawCell(uint16 x, uint16 y);
+ inline void signCell(uint16 x, uint16 y, uint32 value);
+ void signTile(const Tile *tile, uint16 x, uint16 y, bool use_tile_data=false);
+ bool tileHasCycledColours(const Tile *tile);
+ bool updateCellSignatures(bool full_redraw);
 
  void updateLighting();
+ void buildLightList();
+ bool objMightGiveLight(uint16 obj_n);
+ void refreshBlacking();
  void generateTmpMap();
+ void updateObjBoundaryCache();
+ bool tmpBufObjIsBoundary(uint16 x, uint16 y);
  void boundaryFill(unsigned char *map_ptr, uint16 pitch, uint16 x, uint16 y);
  bool floorTilesVisible();
  bool boundaryLookThroughWindow(uint16 tile_num, uint16 x, uint16 y);
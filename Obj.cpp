@@ -38,6 +38,23 @@ Obj::Obj(Obj *sobj)
   parent = NULL; container = NULL;
 };
 
+// Never destroyed, see U6Link::get_pool()
+U6Pool *Obj::get_pool()
+{
+  static U6Pool *pool = new U6Pool("Obj", sizeof(Obj), OBJ_POOL_PAGE_SIZE);
+  return pool;
+}
+
+void *Obj::operator new(size_t size) noexcept
+{
+  return get_pool()->alloc();
+}
+
+void Obj::operator delete(void *ptr)
+{
+  get_pool()->release(ptr);
+}
+
 void Obj::make_container()
 {
   if(container == NULL)
@@ -80,6 +80,8 @@ class Actor;
 //We use this in Obj::is_in_inventory()
 #define OBJ_DONT_CHECK_PARENT false
 
+#define OBJ_POOL_PAGE_SIZE 1024 // objects allocated at once by the object pool
+
 class Obj
 {
   uint8 nuvie_status;
@@ -102,6 +104,10 @@ public:
 public:
   Obj();
   Obj(Obj *sobj);
+
+  static void *operator new(size_t size) noexcept;
+  static void operator delete(void *ptr);
+  static U6Pool *get_pool();
     
   bool is_script_obj()    { return(nuvie_status & NUVIE_OBJ_STATUS_SCRIPTING); }
   bool is_actor_obj()     { return(nuvie_status & NUVIE_OBJ_STATUS_ACTOR_OBJ); }
@@ -35,7 +35,9 @@
 #include "U6objects.h"
 #include "U6LList.h"
 #include "NuvieIOFile.h"
+#include "U6Lzw.h"
 #include "Game.h"
+#include "Console.h"
 #include "MapWindow.h"
 #include "Script.h"
 #include "MsgScroll.h"
@@ -77,10 +79,28 @@ ObjManager::ObjManager(Configuration *cfg, TileManager *tm, EggManager *em)
    dungeon[i] = iAVLAllocTree(get_iAVLKey);
   }
 
+ for(i=0;i<6;i++)
+  {
+   uint16 chunk_pitch = MAP_SIDE_LENGTH(i) >> OBJ_INDEX_CHUNK_SHIFT;
+   obj_index[i] = (ObjIndexChunk **)calloc(chunk_pitch * chunk_pitch, sizeof(ObjIndexChunk *));
+  }
+
+ memset(pending_chunk_data,0,sizeof(pending_chunk_data));
+ memset(pending_chunk_size,0,sizeof(pending_chunk_size));
+ memset(pending_chunk_failed,0,sizeof(pending_chunk_failed));
+ pending_chunk_count = 0;
+
  last_obj_blk_x = 0;
  last_obj_blk_y = 0;
  last_obj_blk_z = OBJ_TEMP_INIT;
 
+ for(i=0;i<6;i++)
+  {
+   passable_cache[i] = NULL;
+   passable_cache_dirty[i] = false;
+  }
+ passable_tile_revision = tile_manager->get_passable_revision();
+
  config->value("config/GameType",game_type);
 
  //save the egg tile_num incase we want to switch egg display on again.
@@ -119,6 +139,13 @@ ObjManager::~ObjManager()
  for(i=0;i<5;i++)
   iAVLFreeTree(dungeon[i], clean_obj_tree_node);
 
+ clean_obj_index();
+ for(i=0;i<6;i++)
+  {
+   free(obj_index[i]);
+   free(passable_cache[i]);
+  }
+
  for(uint16 i=0; i < 256; i++)
   {
    if(actor_inventories[i])
@@ -166,7 +193,7 @@ bool ObjManager::load_weight_table()
 }
 
 
-bool ObjManager::load_super_chunk(NuvieIO *chunk_buf, uint8 level, uint8 chunk_offset)
+bool ObjManager::load_super_chunk(NuvieIOBuffer *chunk_buf, uint8 level, uint8 chunk_offset)
 {
  NuvieIOFileRead file;
  U6LList *list;
@@ -183,7 +210,7 @@ bool ObjManager::load_super_chunk(NuvieIO *chunk_buf, uint8 level, uint8 chunk_o
 
  list = new U6LList();
 
- num_objs = chunk_buf->read2();
+ num_objs = chunk_buf->read2_inline();
  //DEBUG(0,LEVEL_DEBUGGING,"chunk %02d number of objects: %d\n", chunk_offset, num_objs);
 
  for(i=0;i<num_objs;i++)
@@ -280,6 +307,145 @@ bool ObjManager::save_super_chunk(NuvieIO *save_buf, uint8 level, uint8 chunk_of
  return true;
 }
 
+/* Write a super-chunk as a 4 byte length followed by its objects in U6 LZW
+ * form. A super-chunk that was never loaded from the savegame is copied out
+ * as it was read. Returns false without writing anything if the super-chunk
+ * failed to load but objects have since been put there, as copying it out
+ * would lose them.
+ */
+bool ObjManager::save_compressed_super_chunk(NuvieIO *save_buf, uint8 level, uint8 chunk_offset)
+{
+ uint8 n = (level == 0) ? chunk_offset : 63 + level;
+ NuvieIOBufferWrite chunk_buf;
+ unsigned char *lzw_data;
+ uint32 lzw_len;
+ U6Lzw lzw;
+
+ if(pending_chunk_data[n] != NULL)
+   {
+    iAVLCursor node;
+    iAVLTree *obj_tree = (level == 0) ? surface[chunk_offset] : dungeon[level-1];
+    if(pending_chunk_failed[n] && iAVLFirst(&node, obj_tree) != NULL)
+      {
+       DEBUG(0,LEVEL_ERROR,"super-chunk %d failed to load and now has objects, not saving\n", n);
+       ConsoleAddError("Can't save objects left where the savegame was damaged");
+       return false;
+      }
+
+    save_buf->write4(pending_chunk_size[n]);
+    return(save_buf->writeBuf(pending_chunk_data[n], pending_chunk_size[n]) == pending_chunk_size[n]);
+   }
+
+ save_super_chunk(&chunk_buf, level, chunk_offset);
+
+ lzw_data = lzw.compress_buffer(chunk_buf.get_raw_data(), chunk_buf.get_size(), lzw_len);
+ if(lzw_data == NULL)
+   {
+    DEBUG(0,LEVEL_ERROR,"compressing super-chunk %d: %s\n", n, lzw.strerror());
+    return false;
+   }
+
+ save_buf->write4(lzw_len);
+ bool ret = (save_buf->writeBuf(lzw_data, lzw_len) == lzw_len);
+ free(lzw_data);
+
+ return ret;
+}
+
+/* Keep a compressed super-chunk of `size' bytes from `chunk_buf', to be loaded
+ * when its objects are first needed. Returns false if it can't be read or
+ * doesn't start like U6 LZW data.
+ */
+bool ObjManager::add_compressed_super_chunk(NuvieIO *chunk_buf, uint32 size, uint8 level, uint8 chunk_offset)
+{
+ uint8 n = (level == 0) ? chunk_offset : 63 + level;
+ U6Lzw lzw;
+
+ if(n >= OBJ_SUPER_CHUNK_COUNT || pending_chunk_data[n] != NULL)
+   return false;
+
+ unsigned char *data = (unsigned char *)malloc(size);
+ if(data == NULL || chunk_buf->readToBuf(data, size) == false)
+   {
+    DEBUG(0,LEVEL_ERROR,"reading super-chunk %d\n", n);
+    free(data);
+    return false;
+   }
+
+ if(lzw.is_valid_lzw_buffer(data, size) == false)
+   {
+    DEBUG(0,LEVEL_ERROR,"super-chunk %d: %s\n", n, lzw.strerror());
+    free(data);
+    return false;
+   }
+
+ pending_chunk_data[n] = data;
+ pending_chunk_size[n] = size;
+ pending_chunk_count++;
+
+ return true;
+}
+
+/* Decompress and load super-chunk `n' if it is still waiting. Returns true if
+ * any objects were added. A super-chunk that fails to decompress keeps its
+ * compressed data, so saving writes it back as it was instead of empty, as
+ * long as nothing has been put there in the meantime.
+ */
+bool ObjManager::load_pending_super_chunk(uint8 n)
+{
+ unsigned char *data = pending_chunk_data[n];
+ unsigned char *chunk_data;
+ uint32 chunk_len;
+ NuvieIOBuffer chunk_buf;
+ U6Lzw lzw;
+
+ if(data == NULL || pending_chunk_failed[n])
+   return false;
+
+ chunk_data = lzw.decompress_buffer(data, pending_chunk_size[n], chunk_len);
+ if(chunk_data == NULL)
+   {
+    DEBUG(0,LEVEL_ERROR,"loading super-chunk %d: %s\n", n, lzw.strerror());
+    ConsoleAddError("Loading objects failed, the savegame may be damaged");
+    pending_chunk_failed[n] = true;
+    pending_chunk_count--;
+    return false;
+   }
+
+ // it's loaded from here on, so adding its objects doesn't come back here
+ pending_chunk_data[n] = NULL;
+ pending_chunk_count--;
+ free(data);
+
+ chunk_buf.open(chunk_data, chunk_len, NUVIE_BUF_NOCOPY);
+ if(n < 64)
+   load_super_chunk(&chunk_buf, 0, n);
+ else
+   load_super_chunk(&chunk_buf, n - 63, 0);
+ free(chunk_data);
+
+ return true;
+}
+
+/* Load every super-chunk still waiting in the savegame. */
+void ObjManager::load_pending_super_chunks()
+{
+ for(uint8 i=0; pending_chunk_count > 0 && i < OBJ_SUPER_CHUNK_COUNT; i++)
+   load_pending_super_chunk(i);
+}
+
+void ObjManager::clean_pending_super_chunks()
+{
+ for(uint8 i=0; i < OBJ_SUPER_CHUNK_COUNT; i++)
+  {
+   free(pending_chunk_data[i]);
+   pending_chunk_data[i] = NULL;
+   pending_chunk_size[i] = 0;
+   pending_chunk_failed[i] = false;
+  }
+ pending_chunk_count = 0;
+}
+
 bool ObjManager::save_eggs(NuvieIO *save_buf)
 {
  uint32 start_pos;
@@ -429,6 +595,9 @@ void ObjManager::clean()
  for(i=0;i<5;i++)
   iAVLCleanTree(dungeon[i], clean_obj_tree_node);
 
+ clean_obj_index();
+ clean_pending_super_chunks();
+
  clean_actor_inventories();
 
  // remove the temporary object list. The objects were deleted from the surface and dungeon trees.
@@ -439,6 +608,14 @@ void ObjManager::clean()
  }
  tile_obj_list.clear();
 
+ invalidate_passable_cache();
+
+ // with the world objects gone the pools can usually start again from their first page.
+ Obj::get_pool()->reset_if_empty();
+ U6Link::get_pool()->reset_if_empty();
+ Obj::get_pool()->print_stats();
+ U6Link::get_pool()->print_stats();
+
  return;
 }
 
@@ -547,7 +724,81 @@ bool ObjManager::is_door(Obj * obj)
 }
 */
 
+/* Returns OBJ_NOT_PASSABLE if an object blocks the location, OBJ_PASSABLE if
+ * there are only passable objects there, and OBJ_NO_OBJ if nothing is there.
+ */
 uint8 ObjManager::is_passable(uint16 x, uint16 y, uint8 level)
+{
+ uint8 flags = get_passable_flags(x, y, level);
+
+ if(flags & OBJ_PASSCACHE_BLOCKED)
+   return OBJ_NOT_PASSABLE;
+ if(flags & OBJ_PASSCACHE_OBJ)
+   return OBJ_PASSABLE;
+
+ return OBJ_NO_OBJ;
+}
+
+bool ObjManager::is_forced_passable(uint16 x, uint16 y, uint8 level)
+{
+ return (get_passable_flags(x, y, level) & OBJ_PASSCACHE_FORCED);
+}
+
+uint8 ObjManager::find_passable_flags(uint16 x, uint16 y, uint8 level)
+{
+ uint8 flags = OBJ_PASSCACHE_VALID;
+ uint8 obj_status = find_passable(x, y, level);
+
+ if(obj_status == OBJ_NOT_PASSABLE)
+   flags |= OBJ_PASSCACHE_BLOCKED;
+ else if(obj_status == OBJ_PASSABLE)
+   flags |= OBJ_PASSCACHE_OBJ;
+
+ if(find_forced_passable(x, y, level))
+   flags |= OBJ_PASSCACHE_FORCED;
+
+ return flags;
+}
+
+/* Forget the cached passability of every location that objects at x,y can
+ * affect, and tell MapWindow the objects there changed. Double width and
+ * height objects also cover the locations to the west and north.
+ */
+void ObjManager::invalidate_passable(uint16 x, uint16 y, uint8 level)
+{
+ MapWindow *map_window = Game::get_game() ? Game::get_game()->get_map_window() : NULL;
+ if(map_window)
+   map_window->invalidate_obj_cache(x, y, level);
+
+ if(level > 5 || passable_cache[level] == NULL || passable_cache_dirty[level])
+   return;
+
+ uint16 width = MAP_SIDE_LENGTH(level);
+ uint16 x1 = WRAPPED_COORD(x - 1, level);
+ uint16 y1 = WRAPPED_COORD(y - 1, level);
+ x = WRAPPED_COORD(x, level);
+ y = WRAPPED_COORD(y, level);
+
+ passable_cache[level][y * width + x] = 0;
+ passable_cache[level][y * width + x1] = 0;
+ passable_cache[level][y1 * width + x] = 0;
+ passable_cache[level][y1 * width + x1] = 0;
+}
+
+/* Forget the cached passability of every location. Each level is cleared when
+ * it is next checked.
+ */
+void ObjManager::invalidate_passable_cache()
+{
+ MapWindow *map_window = Game::get_game() ? Game::get_game()->get_map_window() : NULL;
+ if(map_window)
+   map_window->invalidate_obj_cache();
+
+ for(uint8 i=0;i<6;i++)
+   passable_cache_dirty[i] = true;
+}
+
+uint8 ObjManager::find_passable(uint16 x, uint16 y, uint8 level)
 {
  U6Link *link;
  U6LList *obj_list;
@@ -609,7 +860,7 @@ uint8 ObjManager::is_passable(uint16 x, uint16 y, uint8 level)
  return OBJ_NO_OBJ;
 }
 
-bool ObjManager::is_forced_passable(uint16 x, uint16 y, uint8 level)
+bool ObjManager::find_forced_passable(uint16 x, uint16 y, uint8 level)
 {
  U6LList *obj_list;
  U6Link *link;
@@ -1098,25 +1349,6 @@ bool ObjManager::has_toptile(Obj *obj)
 
 //gets the linked list of objects at a particular location.
 
-U6LList *ObjManager::get_obj_list(uint16 x, uint16 y, uint8 level)
-{
- iAVLTree *obj_tree;
- iAVLKey key;
- ObjTreeNode *item;
-
- WRAP_COORD(x,level); // wrap on map edge
- WRAP_COORD(y,level);
- 
- obj_tree = get_obj_tree(x,y,level);
- key = get_obj_tree_key(x,y,level);
-
- item = (ObjTreeNode *)iAVLSearch(obj_tree,key);
- if(item)
-  return item->obj_list;
-
- return NULL;
-}
-
 Tile *ObjManager::get_obj_tile(uint16 obj_n, uint8 frame_n)
 {
  return  tile_manager->get_tile(get_obj_tile_num(obj_n)+frame_n);
@@ -1381,6 +1613,7 @@ bool ObjManager::remove_obj_from_map(Obj *obj)
   if(obj_list == NULL)
     return false;
   
+  invalidate_passable(obj);
   obj_list->remove(obj);
   remove_obj(obj);
 
@@ -1604,6 +1837,7 @@ uint16 ObjManager::get_obj_tile_num(Obj *obj) //assume obj_num is < 1024 :)
 void ObjManager::set_obj_tile_num(uint16 obj_num, uint16 tile_num)
 {
  obj_to_tile[obj_num] = tile_num;
+ invalidate_passable_cache();
  return;
 }
 
@@ -1661,6 +1895,8 @@ Obj *ObjManager::find_obj(uint8 level, uint16 obj_n, uint8 quality, bool match_q
  uint8 i;
  Obj *new_obj;
 
+ load_pending_super_chunks();
+
  if(level == 0)
    {
     for(i=0;i<64;i++)
@@ -1726,26 +1962,20 @@ bool ObjManager::add_obj(Obj *obj, bool addOnTop)
  iAVLTree *obj_tree;
  ObjTreeNode *node;
  U6LList *obj_list;
- iAVLKey key;
 
- obj_tree = get_obj_tree(obj->x, obj->y, obj->z);
- key = get_obj_tree_key(obj);
+ obj_list = get_obj_list(obj->x, obj->y, obj->z);
 
- node = (ObjTreeNode *)iAVLSearch(obj_tree,key);
-
- if(node == NULL)
+ if(obj_list == NULL)
    {
+    obj_tree = get_obj_tree(obj->x, obj->y, obj->z);
     obj_list = new U6LList();
 
     node = new ObjTreeNode;
-    node->key = key;
+    node->key = get_obj_tree_key(obj);
     node->obj_list = obj_list;
 
     iAVLInsert(obj_tree, node);
-   }
- else
-   {
-    obj_list = node->obj_list;
+    set_obj_index(obj->x, obj->y, obj->z, obj_list);
    }
 
  if(addOnTop)
@@ -1757,6 +1987,7 @@ bool ObjManager::add_obj(Obj *obj, bool addOnTop)
    temp_obj_list_add(obj);
 
  obj->set_on_map(obj_list); //mark object as on map.
+ invalidate_passable(obj);
  
  return true;
 }
@@ -1785,7 +2016,7 @@ bool ObjManager::addObjToContainer(U6LList *llist, Obj *obj)
  return false;
 }
 
-Obj *ObjManager::loadObj(NuvieIO *buf)
+Obj *ObjManager::loadObj(NuvieIOBuffer *buf)
 {
  uint8 b1,b2;
  Obj *obj;
@@ -1793,7 +2024,7 @@ Obj *ObjManager::loadObj(NuvieIO *buf)
  obj = new Obj();
  //obj->objblk_n = objblk_n;
 
- obj->status = buf->read1();
+ obj->status = buf->read1_inline();
  
  //set new nuvie location bits.
  switch(obj->status & OBJ_STATUS_MASK_GET)
@@ -1804,25 +2035,25 @@ Obj *ObjManager::loadObj(NuvieIO *buf)
    case OBJ_STATUS_READIED : obj->readied(); break;//obj->nuvie_status |= OBJ_LOC_READIED; break;
  }
  
- obj->x = buf->read1(); // h
- b1 = buf->read1();
+ obj->x = buf->read1_inline(); // h
+ b1 = buf->read1_inline();
  obj->x += (b1 & 0x3) << 8;
 
  obj->y = (b1 & 0xfc) >> 2;
- b2 = buf->read1();
+ b2 = buf->read1_inline();
  obj->y += (b2 & 0xf) << 6;
 
  obj->z = (b2 & 0xf0) >> 4;
 
- b1 = buf->read1();
- b2 = buf->read1();
+ b1 = buf->read1_inline();
+ b2 = buf->read1_inline();
  obj->obj_n = b1;
  obj->obj_n += (b2 & 0x3) << 8;
 
  obj->frame_n = (b2 & 0xfc) >> 2;
 
- obj->qty = buf->read1();
- obj->quality = buf->read1();
+ obj->qty = buf->read1_inline();
+ obj->quality = buf->read1_inline();
  if(is_stackable(obj))
    obj->qty = (uint16)(obj->quality << 8) + obj->qty;
 
@@ -1835,6 +2066,12 @@ Obj *ObjManager::loadObj(NuvieIO *buf)
 
 iAVLTree *ObjManager::get_obj_tree(uint16 x, uint16 y, uint8 level)
 {
+ if(level > 5)
+   return NULL;
+
+ if(pending_chunk_count > 0)
+   load_pending_super_chunk(get_super_chunk_n(x, y, level));
+
  if(level == 0)
   {
    x >>= 7; // x = floor(x / 128)   128 = superchunk width
@@ -1843,12 +2080,47 @@ iAVLTree *ObjManager::get_obj_tree(uint16 x, uint16 y, uint8 level)
    return surface[x + y * 8];
   }
 
- if(level > 5)
-   return NULL;
-
  return dungeon[level-1];
 }
 
+/* Returns the super-chunk number of a location, as used by the savegame. The
+ * surface has 64 super-chunks, each dungeon level is a single one.
+ */
+uint8 ObjManager::get_super_chunk_n(uint16 x, uint16 y, uint8 level)
+{
+ if(level == 0)
+   return (x >> 7) + (y >> 7) * 8;
+
+ return 63 + level;
+}
+
+/* Add an object tree's list to the flat object index. Each list stays in the
+ * index until the trees are cleaned.
+ */
+void ObjManager::set_obj_index(uint16 x, uint16 y, uint8 level, U6LList *obj_list)
+{
+ uint16 chunk_pitch = MAP_SIDE_LENGTH(level) >> OBJ_INDEX_CHUNK_SHIFT;
+ ObjIndexChunk **chunk = &obj_index[level][(y >> OBJ_INDEX_CHUNK_SHIFT) * chunk_pitch + (x >> OBJ_INDEX_CHUNK_SHIFT)];
+
+ if(*chunk == NULL)
+   *chunk = (ObjIndexChunk *)calloc(1, sizeof(ObjIndexChunk));
+
+ (*chunk)->obj_list[(y & OBJ_INDEX_CHUNK_MASK) * OBJ_INDEX_CHUNK_SIZE + (x & OBJ_INDEX_CHUNK_MASK)] = obj_list;
+}
+
+void ObjManager::clean_obj_index()
+{
+ for(uint8 i=0;i<6;i++)
+  {
+   uint16 chunk_pitch = MAP_SIDE_LENGTH(i) >> OBJ_INDEX_CHUNK_SHIFT;
+   for(uint32 c=0;c<(uint32)chunk_pitch * chunk_pitch;c++)
+     {
+      free(obj_index[i][c]);
+      obj_index[i][c] = NULL;
+     }
+  }
+}
+
 inline iAVLKey ObjManager::get_obj_tree_key(Obj *obj)
 {
  return get_obj_tree_key(obj->x, obj->y, obj->z);
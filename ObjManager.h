@@ -26,6 +26,7 @@
 
 #include <list>
 #include <cstring>
+#include <cstdlib>
 #include "iAVLTree.h"
 #include "TileManager.h"
 #include "U6LList.h"
@@ -35,6 +36,7 @@ class Configuration;
 class EggManager;
 class UseCode;
 class NuvieIO;
+class NuvieIOBuffer;
 class MapCoord;
 class Actor;
 
@@ -43,6 +45,12 @@ class Actor;
 #define OBJ_NOT_PASSABLE 1
 #define OBJ_PASSABLE     2
 
+//passable cache flags, one byte per map location
+#define OBJ_PASSCACHE_VALID   0x01
+#define OBJ_PASSCACHE_OBJ     0x02 // there is an object at the location
+#define OBJ_PASSCACHE_BLOCKED 0x04 // an object blocks the location
+#define OBJ_PASSCACHE_FORCED  0x08 // an object at the location is forced passable
+
 #define OBJ_WEIGHT_INCLUDE_CONTAINER_ITEMS true
 #define OBJ_WEIGHT_EXCLUDE_CONTAINER_ITEMS false
 
@@ -69,6 +77,18 @@ struct ObjTreeNode
  U6LList *obj_list;
 };
 
+#define OBJ_SUPER_CHUNK_COUNT 69 // 64 surface super-chunks, then the 5 dungeon levels
+
+#define OBJ_INDEX_CHUNK_SHIFT 3 // object index chunks are 8x8 tiles
+#define OBJ_INDEX_CHUNK_SIZE  (1 << OBJ_INDEX_CHUNK_SHIFT)
+#define OBJ_INDEX_CHUNK_MASK  (OBJ_INDEX_CHUNK_SIZE - 1)
+
+// flat lookup of the object trees' lists, one chunk per 8x8 map area
+struct ObjIndexChunk
+{
+ U6LList *obj_list[OBJ_INDEX_CHUNK_SIZE * OBJ_INDEX_CHUNK_SIZE];
+};
+
 Obj *new_obj(uint16 obj_n, uint8 frame_n, uint16 x, uint16 y, uint16 z);
 void delete_obj(Obj *obj);
 
@@ -83,6 +103,13 @@ class ObjManager
  //chunk object trees.
  iAVLTree *surface[64];
  iAVLTree *dungeon[5];
+ ObjIndexChunk **obj_index[6]; // object lists by location, per level (allocated as needed)
+
+ // compressed super-chunks from the savegame that haven't been loaded yet
+ unsigned char *pending_chunk_data[OBJ_SUPER_CHUNK_COUNT];
+ uint32 pending_chunk_size[OBJ_SUPER_CHUNK_COUNT];
+ bool pending_chunk_failed[OBJ_SUPER_CHUNK_COUNT]; // didn't decompress, kept only to be saved again
+ uint16 pending_chunk_count; // pending super-chunks that haven't failed
 
  uint16 obj_to_tile[1024]; //maps object number (index) to tile number.
  uint8 obj_weight[1024];
@@ -103,6 +130,10 @@ class ObjManager
 
  bool custom_actor_tiles;
 
+ uint8 *passable_cache[6]; // object passability of each map location, per level
+ bool passable_cache_dirty[6]; // entire level needs to be recalculated
+ uint32 passable_tile_revision; // TileManager passable revision the cache was made with
+
  public:
 
  ObjManager(Configuration *cfg, TileManager *tm, EggManager *em);
@@ -113,12 +144,15 @@ class ObjManager
  void set_show_eggs(bool value) { show_eggs = value; }
 
  bool loadObjs();
- bool load_super_chunk(NuvieIO *chunk_buf, uint8 level, uint8 chunk_offset);
+ bool load_super_chunk(NuvieIOBuffer *chunk_buf, uint8 level, uint8 chunk_offset);
+ bool add_compressed_super_chunk(NuvieIO *chunk_buf, uint32 size, uint8 level, uint8 chunk_offset);
+ void load_pending_super_chunks();
  void startObjs();
  void clean();
  void clean_actor_inventories();
 
  bool save_super_chunk(NuvieIO *save_buf, uint8 level, uint8 chunk_offset);
+ bool save_compressed_super_chunk(NuvieIO *save_buf, uint8 level, uint8 chunk_offset);
  bool save_eggs(NuvieIO *save_buf);
  bool save_inventories(NuvieIO *save_buf);
  bool save_obj(NuvieIO *save_buf, Obj *obj, uint16 parent_objblk_n);
@@ -143,7 +177,12 @@ class ObjManager
  bool obj_is_damaging(Obj *obj, Actor *actor = NULL); // if actor, it will damage and display text
  bool is_door(uint16 x, uint16 y, uint8 level);
 
- U6LList *get_obj_list(uint16 x, uint16 y, uint8 level);
+ inline uint8 get_passable_flags(uint16 x, uint16 y, uint8 level);
+ void invalidate_passable(uint16 x, uint16 y, uint8 level);
+ void invalidate_passable(Obj *obj) { invalidate_passable(obj->x, obj->y, obj->z); }
+ void invalidate_passable_cache();
+
+ inline U6LList *get_obj_list(uint16 x, uint16 y, uint8 level);
 
  Tile *get_obj_tile(uint16 obj_n, uint8 frame_n);
  Tile *get_obj_tile(uint16 x, uint16 y, uint8 level, bool top_obj = true);
@@ -203,13 +242,22 @@ class ObjManager
 
  void remove_obj(Obj *obj);
  
+ uint8 find_passable_flags(uint16 x, uint16 y, uint8 level);
+ uint8 find_passable(uint16 x, uint16 y, uint8 level);
+ bool find_forced_passable(uint16 x, uint16 y, uint8 level);
+
  bool load_basetile();
  bool load_weight_table();
 
 
  bool addObjToContainer(U6LList *list, Obj *obj);
- Obj *loadObj(NuvieIO *buf);
+ Obj *loadObj(NuvieIOBuffer *buf);
  iAVLTree *get_obj_tree(uint16 x, uint16 y, uint8 level);
+ uint8 get_super_chunk_n(uint16 x, uint16 y, uint8 level);
+ bool load_pending_super_chunk(uint8 n);
+ void clean_pending_super_chunks();
+ void set_obj_index(uint16 x, uint16 y, uint8 level, U6LList *obj_list);
+ void clean_obj_index();
 
  iAVLKey get_obj_tree_key(Obj *obj);
  iAVLKey get_obj_tree_key(uint16 x, uint16 y, uint8 level);
@@ -233,5 +281,67 @@ class ObjManager
 };
 
 
+/* Returns the object list at a location, or NULL if nothing has been there. This
+ * reads the flat object index instead of searching the object trees. A
+ * super-chunk still waiting in the savegame is loaded on its first lookup.
+ */
+inline U6LList *ObjManager::get_obj_list(uint16 x, uint16 y, uint8 level)
+{
+ if(level > 5)
+   return NULL;
+
+ WRAP_COORD(x,level); // wrap on map edge
+ WRAP_COORD(y,level);
+
+ uint16 chunk_pitch = MAP_SIDE_LENGTH(level) >> OBJ_INDEX_CHUNK_SHIFT;
+ ObjIndexChunk *chunk = obj_index[level][(y >> OBJ_INDEX_CHUNK_SHIFT) * chunk_pitch + (x >> OBJ_INDEX_CHUNK_SHIFT)];
+ if(chunk == NULL)
+   {
+    if(pending_chunk_count == 0 || !load_pending_super_chunk(get_super_chunk_n(x, y, level)))
+      return NULL;
+    chunk = obj_index[level][(y >> OBJ_INDEX_CHUNK_SHIFT) * chunk_pitch + (x >> OBJ_INDEX_CHUNK_SHIFT)];
+    if(chunk == NULL)
+      return NULL;
+   }
+
+ return chunk->obj_list[(y & OBJ_INDEX_CHUNK_MASK) * OBJ_INDEX_CHUNK_SIZE + (x & OBJ_INDEX_CHUNK_MASK)];
+}
+
+/* Returns the cached OBJ_PASSCACHE flags for a location, finding them first if
+ * they haven't been set since the location last changed. The cache for a level
+ * is allocated when it is first checked.
+ */
+inline uint8 ObjManager::get_passable_flags(uint16 x, uint16 y, uint8 level)
+{
+ if(level > 5)
+   return find_passable_flags(x, y, level);
+
+ if(passable_tile_revision != tile_manager->get_passable_revision())
+   {
+    invalidate_passable_cache();
+    passable_tile_revision = tile_manager->get_passable_revision();
+   }
+
+ uint16 width = MAP_SIDE_LENGTH(level);
+ if(passable_cache[level] == NULL)
+   {
+    passable_cache[level] = (uint8 *)calloc(width * width, 1);
+    passable_cache_dirty[level] = false;
+   }
+ else if(passable_cache_dirty[level])
+   {
+    memset(passable_cache[level], 0, width * width);
+    passable_cache_dirty[level] = false;
+   }
+
+ WRAP_COORD(x,level);
+ WRAP_COORD(y,level);
+
+ uint8 *flags = &passable_cache[level][y * width + x];
+ if(!(*flags & OBJ_PASSCACHE_VALID))
+   *flags = find_passable_flags(x, y, level);
+
+ return *flags;
+}
 
 #endif /* __ObjManager_h__ */
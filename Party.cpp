@@ -993,7 +993,7 @@ bool Party::can_rest(std::string &err_str)
 		else
 			err_str = "-Not while foes are near!";
 	}
-	else if((all_actors = actor_manager->filter_party(actor_manager->filter_distance(actor_manager->get_actor_list(),
+	else if((all_actors = actor_manager->filter_party(actor_manager->get_actor_list(
 			loc.x,loc.y,loc.z, 5)))
 			&& !all_actors->empty() && !is_in_vehicle())
 	{
@@ -102,6 +102,9 @@ TileManager::TileManager(Configuration *cfg)
 
  extendedTiles = NULL;
  numTiles = NUM_ORIGINAL_TILES;
+ passable_revision = 0;
+ native_tiles = NULL;
+ num_native_tiles = 0;
 
  config->value("config/GameType",game_type);
 }
@@ -115,14 +118,14 @@ TileManager::~TileManager()
  {
    free(extendedTiles);
  }
+ free_native_tiles();
 }
 
 bool TileManager::loadTiles()
 {
  std::string maptiles_path, masktype_path, path;
- NuvieIOFileRead objtiles_vga;
- NuvieIOFileRead tileindx_vga;
- NuvieIOFileRead file;
+ NuvieIOMapped objtiles_vga;
+ NuvieIOMapped tileindx_vga;
  U6Lib_n lib_file;
  U6Lzw *lzw;
  uint32 tile_offset;
@@ -220,7 +223,7 @@ bool TileManager::loadTiles()
 
  for(i=0;i<2048;i++)
   {
-   tile_offset = tileindx_vga.read2() * 16;
+   tile_offset = tileindx_vga.read2_inline() * 16;
    tile[i].tile_num = i;
 
    tile[i].transparent = false;
@@ -324,9 +327,54 @@ Tile *TileManager::get_extended_tile(uint16 tile_num)
   return &tile[0];
 }
 
+/* Returns the screen format copy of a tile owned by TileManager, or NULL if
+ * `t' is some other tile. The copy is only converted when it is drawn.
+ */
+NativeTile *TileManager::get_native_tile(const Tile *t)
+{
+ uint16 n;
+
+ if(t >= tile && t < tile + NUM_ORIGINAL_TILES)
+   n = t - tile;
+ else if(extendedTiles && t >= extendedTiles && t < extendedTiles + (numTiles - NUM_ORIGINAL_TILES))
+   n = NUM_ORIGINAL_TILES + (t - extendedTiles);
+ else
+   return NULL;
+
+ if(num_native_tiles != numTiles)
+   {
+    free_native_tiles();
+    native_tiles = (NativeTile *)calloc(numTiles, sizeof(NativeTile));
+    if(native_tiles == NULL)
+      return NULL;
+    num_native_tiles = numTiles;
+   }
+
+ return &native_tiles[n];
+}
+
+/* Forget the screen format copies, after tiles have been loaded or replaced. */
+void TileManager::free_native_tiles()
+{
+ free(native_tiles);
+ native_tiles = NULL;
+ num_native_tiles = 0;
+}
+
 // set entry in tileindex[] to tile num
 void TileManager::set_tile_index(uint16 tile_index, uint16 tile_num)
 {
+    update_tile_index(tile_index, tile_num);
+}
+
+// set entry in tileindex[], noting if the animated tile stopped or started
+// forcing its location passable or being a boundary. (ObjManager and
+// MapWindow cache those)
+inline void TileManager::update_tile_index(uint16 tile_index, uint16 tile_num)
+{
+    if(((tile[tileindex[tile_index]].flags3 ^ tile[tile_num].flags3) & TILEFLAG_FORCED_PASSABLE)
+       || ((tile[tileindex[tile_index]].flags2 ^ tile[tile_num].flags2) & TILEFLAG_BOUNDARY))
+        passable_revision++;
     tileindex[tile_index] = tile_num;
 }
 
@@ -400,7 +448,7 @@ void TileManager::update()
         else if(animdata.loop[i] == 1) // get previous frame
           current_anim_frame = (rgame_counter & animdata.and_masks[i]) >> animdata.shift_values[i];
         prev_tileindex = tileindex[animdata.tile_to_animate[i]];
-        tileindex[animdata.tile_to_animate[i]] = tileindex[animdata.first_anim_frame[i] + current_anim_frame];
+        update_tile_index(animdata.tile_to_animate[i], tileindex[animdata.first_anim_frame[i] + current_anim_frame]);
         // loop complete if back to first frame (and not infinite loop)
         if(animdata.loop_count[i] > 0
            && tileindex[animdata.tile_to_animate[i]] != prev_tileindex
@@ -408,7 +456,7 @@ void TileManager::update()
           --animdata.loop_count[i];
        }
      else // not animating
-        tileindex[animdata.tile_to_animate[i]] = tileindex[animdata.first_anim_frame[i]];
+        update_tile_index(animdata.tile_to_animate[i], tileindex[animdata.first_anim_frame[i]]);
     }
 
  if(Game::get_game()->anims_paused() == false) // update counter
@@ -432,7 +480,7 @@ void TileManager::update()
 bool TileManager::loadTileFlag()
 {
  std::string filename;
- NuvieIOFileRead file;
+ NuvieIOMapped file;
  uint16 i;
 
  config_get_path(config,"tileflag",filename);
@@ -442,7 +490,7 @@ bool TileManager::loadTileFlag()
 
  for(i=0;i < 2048; i++)
   {
-   tile[i].flags1 = file.read1();
+   tile[i].flags1 = file.read1_inline();
    if(tile[i].flags1 & 0x2)
      tile[i].passable = false;
    else
@@ -461,7 +509,7 @@ bool TileManager::loadTileFlag()
 
  for(i=0;i < 2048; i++)
   {
-   tile[i].flags2 = file.read1();
+   tile[i].flags2 = file.read1_inline();
    if(tile[i].flags2 & 0x10)
      tile[i].toptile = true;
    else
@@ -488,7 +536,7 @@ bool TileManager::loadTileFlag()
 
  for(i=0;i < 2048; i++) // '', 'a', 'an', 'the'
   {
-   tile[i].flags3 = file.read1();
+   tile[i].flags3 = file.read1_inline();
    tile[i].article_n = (tile[i].flags3 & 0xC0) >> 6;
   }
 
@@ -924,6 +972,11 @@ Tile *TileManager::loadCustomTiles(const std::string filename, bool overwrite_ti
     }
   }
 
+  if(copy_tileflags)
+    passable_revision++;
+
+  free_native_tiles();
+
   return newTilePtr;
 }
 
@@ -972,6 +1025,8 @@ void TileManager::freeCustomTiles()
     free(extendedTiles);
     extendedTiles = NULL;
     numTiles = NUM_ORIGINAL_TILES;
+    passable_revision++;
+    free_native_tiles();
   }
 }
 
@@ -130,6 +130,23 @@ uint8 flags3;
 unsigned char data[256];
 } Tile;
 
+/* A tile converted to the screen's pixel format by Screen::blit_tile(), with
+ * the opaque pixels of each row stored as runs that can be copied directly.
+ */
+typedef struct {
+bool built; // false until the pixels have been converted
+bool transparent; // Tile::transparent when converted
+bool cycled; // uses palette entries that GamePalette rotates
+uint32 palette_revision; // Screen palette revisions when converted
+uint32 palette_set_revision;
+
+uint8 num_runs[TILE_HEIGHT]; // opaque runs in each row
+uint8 run_start[TILE_HEIGHT][TILE_WIDTH/2];
+uint8 run_len[TILE_HEIGHT][TILE_WIDTH/2];
+
+uint32 pixels[TILE_DATA_SIZE]; // 16 or 32bpp pixels, packed by row
+} NativeTile;
+
 
 typedef struct {
 uint16 number_of_tiles_to_animate;
@@ -157,6 +174,11 @@ class TileManager
  Tile *extendedTiles;
  uint16 numTiles;
 
+ uint32 passable_revision; // changed whenever a tile's forced passable or boundary flag may have changed
+
+ NativeTile *native_tiles; // screen format copies of tile[] then extendedTiles, made when first drawn
+ uint16 num_native_tiles;
+
  public:
 
    TileManager(Configuration *cfg);
@@ -169,6 +191,8 @@ class TileManager
    void set_tile_index(uint16 tile_index, uint16 tile_num);
    uint16 get_tile_index(uint16 tile_index) { return(tileindex[tile_index]); }
    void set_anim_loop(uint16 tile_num, sint8 loopc, uint8 loop = 0);
+   uint32 get_passable_revision() { return(passable_revision); }
+   NativeTile *get_native_tile(const Tile *t);
 
    const char *lookAtTile(uint16 tile_num, uint16 qty, bool show_prefix);
    bool tile_is_stackable(uint16 tile_num);
@@ -204,7 +228,9 @@ class TileManager
  private:
 
    Tile *get_extended_tile(uint16 tile_num);
+   inline void update_tile_index(uint16 tile_index, uint16 tile_num);
    void copyTileMetaData(Tile *dest, Tile *src);
+   void free_native_tiles();
    Tile *addNewTiles(uint16 num_tiles);
 
    void writeBmpTileData(unsigned char *data, Tile *t, bool transparent);
@@ -42,18 +42,13 @@ void TimeQueue::call_timers(uint32 now)
  */
 void TimeQueue::add_timer(TimedEvent *tevent)
 {
-    std::list<TimedEvent *>::iterator t;
-    if(tq.empty())
-    {
-        tq.push_front(tevent);
-        return;
-    }
-    // in case it's already queued, remove the earlier instance(s)
+    // in case it's already queued, remove the earlier instance
     remove_timer(tevent);
     // add after events with earlier/equal time
-    t = tq.begin();
-    while(t != tq.end() && (*t)->time <= tevent->time) t++;
-    tq.insert(t, tevent);
+    tevent->tq_order = ++add_count;
+    tevent->tq_index = tq.size();
+    tq.push_back(tevent);
+    heap_up(tevent->tq_index);
 }
 
 
@@ -61,16 +56,9 @@ void TimeQueue::add_timer(TimedEvent *tevent)
  */
 void TimeQueue::remove_timer(TimedEvent *tevent)
 {
-    std::list<TimedEvent *>::iterator t;
-    t = tq.begin();
-    while(t != tq.end())
-      {
-        if(*t == tevent)
-        {
-            t = tq.erase(t);
-        }
-        else ++t; // this deletes all duplicates
-      }
+    sint32 i = tevent->tq_index;
+    if(i >= 0 && (uint32)i < tq.size() && tq[i] == tevent)
+        heap_remove(i);
 }
 
 
@@ -82,12 +70,85 @@ TimedEvent *TimeQueue::pop_timer()
     if(!empty())
     {
         first = tq.front();
-        tq.pop_front(); // remove it
+        heap_remove(0); // remove it
     }
     return(first);
 }
 
 
+/* Returns true if `t1' should activate before `t2'.
+ */
+bool TimeQueue::timer_before(TimedEvent *t1, TimedEvent *t2)
+{
+    if(t1->time != t2->time)
+        return(t1->time < t2->time);
+    return(t1->tq_order < t2->tq_order);
+}
+
+
+/* Move the event at heap position `i' up to its place.
+ */
+void TimeQueue::heap_up(uint32 i)
+{
+    TimedEvent *tevent = tq[i];
+    while(i > 0)
+    {
+        uint32 parent = (i - 1) / 2;
+        if(!timer_before(tevent, tq[parent]))
+            break;
+        tq[i] = tq[parent];
+        tq[i]->tq_index = i;
+        i = parent;
+    }
+    tq[i] = tevent;
+    tevent->tq_index = i;
+}
+
+
+/* Move the event at heap position `i' down to its place.
+ */
+void TimeQueue::heap_down(uint32 i)
+{
+    uint32 size = tq.size();
+    TimedEvent *tevent = tq[i];
+    while(true)
+    {
+        uint32 child = i * 2 + 1;
+        if(child >= size)
+            break;
+        if(child + 1 < size && timer_before(tq[child + 1], tq[child]))
+            ++child;
+        if(!timer_before(tq[child], tevent))
+            break;
+        tq[i] = tq[child];
+        tq[i]->tq_index = i;
+        i = child;
+    }
+    tq[i] = tevent;
+    tevent->tq_index = i;
+}
+
+
+/* Take the event at heap position `i' out of the queue.
+ */
+void TimeQueue::heap_remove(uint32 i)
+{
+    TimedEvent *tevent = tq[i];
+    TimedEvent *last = tq.back();
+    tq.pop_back();
+    tevent->tq_index = -1;
+    if(last == tevent)
+        return;
+    // fill the hole with the last event and move it to its place
+    tq[i] = last;
+    last->tq_index = i;
+    if(i > 0 && timer_before(last, tq[(i - 1) / 2]))
+        heap_up(i);
+    else
+        heap_down(i);
+}
+
+
 /* Call timed event at front of queue, whose time is <= `now'.
  * Returns true if an event handler was called. (false if time isn't up yet)
  */
@@ -147,7 +208,8 @@ bool TimeQueue::delete_timer(TimedEvent *tevent)
  */
 TimedEvent::TimedEvent(uint32 reltime, bool immediate, bool realtime)
             : delay(reltime), repeat_count(0), ignore_pause(false),
-              real_time(realtime), tq_can_delete(true), defunct(false)
+              real_time(realtime), tq_can_delete(true), defunct(false),
+              tq_index(-1), tq_order(0)
 {
     tq = NULL;
 
@@ -2,6 +2,7 @@
 #define __TimedEvent_h__
 
 #include <list>
+#include <vector>
 #include <string>
 #include <cstdio>
 #include "CallBack.h"
@@ -18,13 +19,16 @@ class Party;
 class TimedCallbackTarget;
 class TimedEvent;
 
-/* A queue for our events.
+/* A queue for our events. Events are kept in a binary heap, ordered by time
+ * and then by when they were added, so events with equal times activate in
+ * the order they were queued.
  */
 class TimeQueue
 {
-    std::list<TimedEvent *> tq;
+    std::vector<TimedEvent *> tq; // heap, earliest event first
+    uint32 add_count; // number of events added, for ordering equal times
 public:
-    TimeQueue() : tq() { }
+    TimeQueue() : tq(), add_count(0) { }
     ~TimeQueue() { clear(); }
 
     bool empty() { return(tq.empty()); }
@@ -37,6 +41,12 @@ public:
 
     bool call_timer(uint32 now); // activate
     void call_timers(uint32 now); // activate all
+
+protected:
+    bool timer_before(TimedEvent *t1, TimedEvent *t2);
+    void heap_up(uint32 i);
+    void heap_down(uint32 i);
+    void heap_remove(uint32 i);
 };
 
 
@@ -61,6 +71,8 @@ protected:
     bool real_time; // time and delay is in milliseconds (false=game ticks/turns)
     bool tq_can_delete; // can TimeQueue delete this TimedEvent when done?
     bool defunct; // deleted; don't activate (use to stop timers from outside)
+    sint32 tq_index; // position in the TimeQueue heap, or -1 if not queued
+    uint32 tq_order; // TimeQueue add count when queued, to keep equal times in order
 
 public:
     TimedEvent(uint32 reltime, bool immediate = TIMER_DELAYED, bool realtime = TIMER_REALTIME);
@@ -131,6 +131,7 @@ void Actor::init_from_obj(Obj *obj, bool change_base_obj)
  x = obj->x;
  y = obj->y;
  z = obj->z;
+ update_actor_index();
 
  if(change_base_obj)
  {
@@ -567,6 +568,7 @@ bool Actor::move(uint16 new_x, uint16 new_y, uint8 new_z, ActorMoveFlags flags)
  x = WRAPPED_COORD(new_x,new_z); // FIXME: this is probably needed because PathFinder is not wrapping coords
  y = WRAPPED_COORD(new_y,new_z);
  z = new_z;
+ update_actor_index();
 
  can_move = true;
  //FIXME move this into Player::moveRelative()
@@ -1594,11 +1596,22 @@ Obj *Actor::make_obj()
  return obj;
 }
 
+/* Let ActorManager know this actor's location changed, so get_actor(x,y,z)
+ * can find it.
+ */
+void Actor::update_actor_index()
+{
+ ActorManager *actor_manager = Game::get_game()->get_actor_manager();
+ if(actor_manager)
+   actor_manager->update_actor_index(this);
+}
+
 void Actor::clear()
 {
  x = 0;
  y = 0;
  z = 0;
+ update_actor_index();
  hide();
  Actor::set_worktype(0);
  light = 0;
@@ -1762,6 +1775,7 @@ void Actor::resurrect(MapCoord new_position, Obj *body_obj)
 	x = new_position.x;
 	y = new_position.y;
 	z = new_position.z;
+	update_actor_index();
 	obj_n = base_obj_n;
 	init((Game::get_game()->get_game_type() == NUVIE_GAME_U6 && id_n == 130)
 	      ? OBJ_STATUS_MUTANT : NO_OBJ_STATUS);
@@ -2097,7 +2111,7 @@ ActorList *Actor::find_enemies()
 {
     const uint8 in_range = 24;
     ActorManager *actor_mgr = Game::get_game()->get_actor_manager();
-    ActorList *actors = actor_mgr->filter_distance(actor_mgr->get_actor_list(), x,y,z, in_range);
+    ActorList *actors = actor_mgr->get_actor_list(x,y,z, in_range);
     actor_mgr->filter_alignment(actors, alignment); // filter own alignment
     if(alignment != ACTOR_ALIGNMENT_CHAOTIC)
     {
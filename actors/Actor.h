@@ -521,6 +521,7 @@ class Actor
  Obj *find_body();
  uint16 get_tile_num(uint16 obj_num);
  uint8 get_num_light_sources() { return light_source.size(); }
+ void update_actor_index(); // call after changing x, y or z
 
  private:
 
@@ -66,6 +66,7 @@ ActorManager::ActorManager(Configuration *cfg, Map *m, TileManager *tm, ObjManag
  for(i = 0; i < ACTORMANAGER_MAX_ACTORS; i++)
    actors[i] = NULL;
  temp_actor_offset = 224;
+ clean_actor_index();
  init();
 }
 
@@ -105,6 +106,7 @@ void ActorManager::clean()
      }
   }
 
+ clean_actor_index();
  init();
 
  return;
@@ -361,6 +363,8 @@ bool ActorManager::load(NuvieIO *objlist)
 	 //a->hide();
  }
 
+ rebuild_actor_index();
+
  updateSchedules();
  loadCustomTiles(game_type);
 
@@ -573,14 +577,65 @@ Actor *ActorManager::get_actor(uint8 actor_num)
  return actors[actor_num];
 }
 
+static bool cmp_actor_num(Actor *a1, Actor *a2)
+{
+ return(a1->get_actor_num() < a2->get_actor_num());
+}
+
+/* Returns a new list of actors within `dist' of a location, on the same level,
+ * in actor number order. Only the indexed map chunks around x,y are checked.
+ */
+ActorList *ActorManager::get_actor_list(uint16 x, uint16 y, uint8 z, uint16 dist)
+{
+ ActorList *_actors = new ActorList;
+ MapCoord loc(x, y, z);
+ sint32 map_chunks = MAP_SIDE_LENGTH(z) >> ACTOR_INDEX_CHUNK_SHIFT;
+ sint32 chunk_dist = (dist >> ACTOR_INDEX_CHUNK_SHIFT) + 1;
+ sint32 cx1 = (x >> ACTOR_INDEX_CHUNK_SHIFT) - chunk_dist, cx2 = (x >> ACTOR_INDEX_CHUNK_SHIFT) + chunk_dist;
+ sint32 cy1 = (y >> ACTOR_INDEX_CHUNK_SHIFT) - chunk_dist, cy2 = (y >> ACTOR_INDEX_CHUNK_SHIFT) + chunk_dist;
+
+ // only the surface wraps around horizontally
+ if(cx2 - cx1 + 1 >= map_chunks)
+   { cx1 = 0; cx2 = map_chunks - 1; }
+ else if(z != 0)
+   { cx1 = clamp_min(cx1, 0); cx2 = clamp_max(cx2, map_chunks - 1); }
+ cy1 = clamp_min(cy1, 0);
+ cy2 = clamp_max(cy2, map_chunks - 1);
+
+ for(sint32 cy = cy1; cy <= cy2; cy++)
+   for(sint32 cx = cx1; cx <= cx2; cx++)
+     {
+      uint16 chunk_x = (cx + map_chunks) % map_chunks;
+      uint16 chunk_y = cy;
+      std::unordered_map<uint32, std::vector<uint8> >::iterator chunk =
+        actor_index.find(get_actor_index_key(chunk_x << ACTOR_INDEX_CHUNK_SHIFT, chunk_y << ACTOR_INDEX_CHUNK_SHIFT, z));
+      if(chunk == actor_index.end())
+        continue;
+      for(std::vector<uint8>::iterator id = chunk->second.begin(); id != chunk->second.end(); id++)
+        {
+         Actor *actor = actors[*id];
+         MapCoord actor_loc(actor->x, actor->y, actor->z);
+         if(loc.distance(actor_loc) <= dist)
+           _actors->push_back(actor);
+        }
+     }
+
+ std::sort(_actors->begin(), _actors->end(), cmp_actor_num);
+ return _actors;
+}
+
 Actor *ActorManager::get_actor(uint16 x, uint16 y, uint8 z, bool inc_surrounding_objs, Actor *excluded_actor)
 {
- uint16 i;
+ std::unordered_map<uint32, std::vector<uint8> >::iterator chunk = actor_index.find(get_actor_index_key(x, y, z));
 
- for(i=0;i<ACTORMANAGER_MAX_ACTORS;i++)
+ if(chunk != actor_index.end())
   {
-   if(actors[i]->x == x && actors[i]->y == y && actors[i]->z == z && actors[i] != excluded_actor)
-     return actors[i];
+   for(std::vector<uint8>::iterator id = chunk->second.begin(); id != chunk->second.end(); id++)
+     {
+      Actor *actor = actors[*id];
+      if(actor->x == x && actor->y == y && actor->z == z && actor != excluded_actor)
+        return actor;
+     }
   }
 
  if(inc_surrounding_objs)
@@ -630,6 +685,45 @@ Actor *ActorManager::get_multi_tile_actor(uint16 x, uint16 y, uint8 z)
 	return NULL;
 }
 
+/* Move an actor to the index chunk for its current location. This must be
+ * called whenever the actor's x, y or z is changed.
+ */
+void ActorManager::update_actor_index(Actor *actor)
+{
+ uint8 id_n = actor->id_n;
+ if(actors[id_n] != actor)
+   return;
+
+ uint32 key = get_actor_index_key(actor->x, actor->y, actor->z);
+ if(actor_index_key[id_n] == key)
+   return;
+
+ if(actor_index_key[id_n] != ACTOR_INDEX_NONE)
+   {
+    std::vector<uint8> &old_ids = actor_index[actor_index_key[id_n]];
+    old_ids.erase(std::find(old_ids.begin(), old_ids.end(), id_n));
+   }
+
+ std::vector<uint8> &ids = actor_index[key];
+ ids.insert(std::lower_bound(ids.begin(), ids.end(), id_n), id_n);
+ actor_index_key[id_n] = key;
+}
+
+void ActorManager::rebuild_actor_index()
+{
+ clean_actor_index();
+ for(uint16 i = 0; i < ACTORMANAGER_MAX_ACTORS; i++)
+   if(actors[i])
+     update_actor_index(actors[i]);
+}
+
+void ActorManager::clean_actor_index()
+{
+ actor_index.clear();
+ for(uint16 i = 0; i < ACTORMANAGER_MAX_ACTORS; i++)
+   actor_index_key[i] = ACTOR_INDEX_NONE;
+}
+
 Actor *ActorManager::get_avatar()
 {
 	return get_actor(ACTOR_AVATAR_ID_N);
@@ -864,6 +958,7 @@ bool ActorManager::create_temp_actor(uint16 obj_n, uint8 obj_status, uint16 x, u
    actor->x = x;
    actor->y = y;
    actor->z = z;
+   update_actor_index(actor);
    
    actor->temp_actor = true;
 
@@ -26,6 +26,8 @@
 
 #include <string>
 #include <set>
+#include <vector>
+#include <unordered_map>
 #include "ObjManager.h"
 #include "ActorList.h"
 
@@ -40,6 +42,9 @@ class MapCoord;
 
 #define ACTORMANAGER_MAX_ACTORS 256
 
+#define ACTOR_INDEX_CHUNK_SHIFT 3 // actors are indexed by 8x8 map chunk
+#define ACTOR_INDEX_NONE 0xffffffff
+
 class ActorManager
 {
  Configuration *config;
@@ -63,6 +68,9 @@ class ActorManager
  uint8 cur_z;
  MapCoord *cmp_actor_loc; // data for sort_distance() & cmp_distance_to_loc()
 
+ std::unordered_map<uint32, std::vector<uint8> > actor_index; // actor ids (ascending) by map chunk
+ uint32 actor_index_key[ACTORMANAGER_MAX_ACTORS]; // chunk each actor is listed in
+
  public:
 
  ActorManager(Configuration *cfg, Map *m, TileManager *tm, ObjManager *om, GameClock *c);
@@ -75,6 +83,7 @@ class ActorManager
  bool save(NuvieIO *objlist);
  // ActorList
  ActorList *get_actor_list(); // *returns a NEW list*
+ ActorList *get_actor_list(uint16 x, uint16 y, uint8 z, uint16 dist); // *returns a NEW list* of actors within dist
  ActorList *sort_nearest(ActorList *list, uint16 x, uint16 y, uint8 z); // ascending distance
  ActorList *filter_distance(ActorList *list, uint16 x, uint16 y, uint8 z, uint16 dist);
  ActorList *filter_alignment(ActorList *list, uint8 align);
@@ -102,6 +111,7 @@ class ActorManager
  void updateSchedules(bool teleport = false);
 
  void clear_actor(Actor *actor);
+ void update_actor_index(Actor *actor);
  bool resurrect_actor(Obj *actor_obj, MapCoord new_position);
 
  bool is_temp_actor(Actor *actor);
@@ -128,6 +138,10 @@ class ActorManager
 
  inline void clean_temp_actor(Actor *actor);
 
+ uint32 get_actor_index_key(uint16 x, uint16 y, uint8 z) { return(((uint32)z << 26) | ((uint32)(y >> ACTOR_INDEX_CHUNK_SHIFT) << 13) | (x >> ACTOR_INDEX_CHUNK_SHIFT)); }
+ void rebuild_actor_index();
+ void clean_actor_index();
+
  private:
 
  bool loadCustomTiles(nuvie_game_t game_type);
@@ -1838,39 +1838,37 @@ function actor_update_all()
          end
          
          local player_z = player_loc.z
-         for i=0,0xff do
-            local actor = Actor.get(i)
-            if actor.obj_n ~= 0 and actor.z == player_z and actor.mpts > 0 and actor.paralyzed == false and actor.asleep == false and actor.wt ~= WT_NOTHING and actor.alive == true then
-                  if abs(actor.x - var_C) > 0x27 or abs(actor.y - var_A) > 0x27 then
-                     if actor.wt >= 0x83 and actor.wt <= 0x86 then
-                        --move actor to schedule location if it isn't on screen
-                        local sched_loc = actor.sched_loc
-                        if map_is_on_screen(sched_loc.x, sched_loc.y, sched_loc.z) == false then
-                        	Actor.move(actor, sched_loc.x, sched_loc.y, sched_loc.z)
-                        	actor_wt_walk_to_location(actor) --this will cancel the pathfinder and set the new worktype
-                        	subtract_movement_pts(actor, 10)
-                        	----dgb("\nActor SCHEDULE TELEPORT "..actor.actor_num.." to ("..sched_loc.x..","..sched_loc.y..","..sched_loc.z..")\n")
-                        end
-                     end
-                  else
-                     if actor.wt ~= WT_FOLLOW then
-                        if actor.wt == 0x80 then
-                           -- actor_set_worktype_from_schedule(actor)
-                           actor.wt = actor.sched_wt
-                        end
-                        
-                        local dx = (actor.mpts * dex_6) - actor.dex * di
-                        if actor.mpts >= actor.dex or dx > 0 or dx == 0 and actor.dex > dex_6 then
-                           selected_actor = actor
-                           di = actor.mpts
-                           dex_6 = actor.dex
-                        end
-                        
-                        if actor.mpts >= actor.dex then
-                           break
-                        end
-                     end
+         for _,actor in ipairs(actors_ready_to_move(player_z)) do
+            local x, y, wt, mpts, dex = Actor.get_props(actor, "x", "y", "wt", "mpts", "dex")
+            if abs(x - var_C) > 0x27 or abs(y - var_A) > 0x27 then
+               if wt >= 0x83 and wt <= 0x86 then
+                  --move actor to schedule location if it isn't on screen
+                  local sched_loc = actor.sched_loc
+                  if map_is_on_screen(sched_loc.x, sched_loc.y, sched_loc.z) == false then
+                  	Actor.move(actor, sched_loc.x, sched_loc.y, sched_loc.z)
+                  	actor_wt_walk_to_location(actor) --this will cancel the pathfinder and set the new worktype
+                  	subtract_movement_pts(actor, 10)
+                  	----dgb("\nActor SCHEDULE TELEPORT "..actor.actor_num.." to ("..sched_loc.x..","..sched_loc.y..","..sched_loc.z..")\n")
                   end
+               end
+            else
+               if wt ~= WT_FOLLOW then
+                  if wt == 0x80 then
+                     -- actor_set_worktype_from_schedule(actor)
+                     actor.wt = actor.sched_wt
+                  end
+                  
+                  local dx = (mpts * dex_6) - dex * di
+                  if mpts >= dex or dx > 0 or dx == 0 and dex > dex_6 then
+                     selected_actor = actor
+                     di = mpts
+                     dex_6 = dex
+                  end
+                  
+                  if mpts >= dex then
+                     break
+                  end
+               end
             end
          end
          
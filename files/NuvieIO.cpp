@@ -121,36 +121,17 @@ void NuvieIOBuffer::close()
 
 uint8 NuvieIOBuffer::read1()
 {
- if(pos >= size)
-   return 0;
-
- return data[pos++];
+ return read1_inline();
 }
 
 uint16 NuvieIOBuffer::read2()
 {
- uint16 val;
-
-  if(pos > size-2)
-   return 0;
-
- val = data[pos] + (data[pos+1]<<8);
- pos += 2;
-
- return val;
+ return read2_inline();
 }
 
 uint32 NuvieIOBuffer::read4()
 {
- uint32 val;
-
- if(pos > size-4)
-   return 0;
-
- val = (data[pos] + (data[pos+1]<<8) + (data[pos+2]<<16) + (data[pos+3]<<24));
- pos += 4;
-
- return val;
+ return read4_inline();
 }
 
 bool NuvieIOBuffer::readToBuf(unsigned char *buf, uint32 buf_size)
@@ -230,3 +211,111 @@ void NuvieIOBuffer::seek(uint32 new_pos)
     if(data && new_pos < size)
         pos = new_pos;
 }
+
+
+// NuvieIOBufferWrite
+
+NuvieIOBufferWrite::NuvieIOBufferWrite() : NuvieIOBuffer()
+{
+ capacity = 0;
+}
+
+NuvieIOBufferWrite::~NuvieIOBufferWrite()
+{
+ close();
+}
+
+void NuvieIOBufferWrite::close()
+{
+ capacity = 0;
+ NuvieIOBuffer::close();
+}
+
+// make room for `write_size' bytes at the current position.
+bool NuvieIOBufferWrite::reserve(uint32 write_size)
+{
+ uint32 new_capacity;
+ unsigned char *new_data;
+
+ if(pos + write_size <= capacity)
+   return true;
+
+ new_capacity = capacity ? capacity : 4096;
+ while(new_capacity < pos + write_size)
+   new_capacity *= 2;
+
+ new_data = (unsigned char *)realloc(data, new_capacity);
+ if(new_data == NULL)
+   {
+    DEBUG(0,LEVEL_ERROR,"NuvieIOBufferWrite::reserve() allocating %d bytes.\n",new_capacity);
+    return false;
+   }
+
+ data = new_data;
+ copied_data = true;
+ capacity = new_capacity;
+
+ return true;
+}
+
+bool NuvieIOBufferWrite::write1(uint8 src)
+{
+ if(reserve(1) == false)
+   return false;
+
+ data[pos++] = src;
+ if(pos > size)
+   size = pos;
+
+ return true;
+}
+
+bool NuvieIOBufferWrite::write2(uint16 src)
+{
+ if(reserve(2) == false)
+   return false;
+
+ data[pos] = src & 0xff;
+ data[pos+1] = (src >> 8) & 0xff;
+ pos += 2;
+ if(pos > size)
+   size = pos;
+
+ return true;
+}
+
+bool NuvieIOBufferWrite::write4(uint32 src)
+{
+ if(reserve(4) == false)
+   return false;
+
+ data[pos] = src & 0xff;
+ data[pos+1] = (src >> 8) & 0xff;
+ data[pos+2] = (src >> 16) & 0xff;
+ data[pos+3] = (src >> 24) & 0xff;
+ pos += 4;
+ if(pos > size)
+   size = pos;
+
+ return true;
+}
+
+uint32 NuvieIOBufferWrite::writeBuf(const unsigned char *src, uint32 src_size)
+{
+ if(src == NULL || reserve(src_size) == false)
+   return 0;
+
+ memcpy(&data[pos],src,src_size);
+ pos += src_size;
+ if(pos > size)
+   size = pos;
+
+ return src_size;
+}
+
+// unlike NuvieIOBuffer, seeking to the end is allowed so writing can carry on there.
+void NuvieIOBufferWrite::seek(uint32 new_pos)
+{
+ if(new_pos <= size)
+   pos = new_pos;
+}
@@ -91,6 +91,24 @@ class NuvieIOBuffer: public NuvieIO
    uint32 read4();
    bool readToBuf(unsigned char *buf, uint32 buf_size);
 
+   // Non-virtual versions of read1/2/4 for loaders that know they have a
+   // buffer. They return 0 past the end, like the virtual ones.
+   inline uint8 read1_inline() { return (pos < size ? data[pos++] : 0); };
+   inline uint16 read2_inline()
+   {
+    if(pos + 2 > size)
+      return 0;
+    pos += 2;
+    return (data[pos-2] + (data[pos-1]<<8));
+   };
+   inline uint32 read4_inline()
+   {
+    if(pos + 4 > size)
+      return 0;
+    pos += 4;
+    return (data[pos-4] + (data[pos-3]<<8) + (data[pos-2]<<16) + ((uint32)data[pos-1]<<24));
+   };
+
    bool write1(uint8 src);
    bool write2(uint16 src);
    bool write4(uint32 src);
@@ -99,4 +117,28 @@ class NuvieIOBuffer: public NuvieIO
 
    void seek(uint32 new_pos);
 };
+
+/* A buffer that grows as it is written to, for building a file in memory. */
+class NuvieIOBufferWrite: public NuvieIOBuffer
+{
+ protected:
+
+ uint32 capacity;
+
+ public:
+   NuvieIOBufferWrite();
+   ~NuvieIOBufferWrite();
+
+   void close();
+
+   bool write1(uint8 src);
+   bool write2(uint16 src);
+   bool write4(uint32 src);
+   uint32 writeBuf(const unsigned char *src, uint32 src_size);
+
+   void seek(uint32 new_pos);
+
+ protected:
+   bool reserve(uint32 write_size);
+};
 #endif /* __NuvieIO_h__ */
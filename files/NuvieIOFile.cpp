@@ -21,6 +21,15 @@
  *
  */
 
+#include <cstdlib>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "nuvieDefs.h"
 
 #include "NuvieIOFile.h"
@@ -224,3 +233,83 @@ uint32 NuvieIOFileWrite::write(NuvieIO *src)
 {
  return 0;
 }
+
+
+// NuvieIOMapped
+//
+
+NuvieIOMapped::NuvieIOMapped(): NuvieIOBuffer()
+{
+ mapped = false;
+}
+
+NuvieIOMapped::~NuvieIOMapped()
+{
+ close();
+}
+
+bool NuvieIOMapped::open(const char *filename)
+{
+ if(data != NULL || size != 0) //We already have a file open lets bail.
+  return false;
+
+#ifndef WIN32
+ int fd = ::open(filename, O_RDONLY);
+ if(fd != -1)
+  {
+   struct stat sb;
+   void *map = MAP_FAILED;
+
+   if(fstat(fd, &sb) == 0 && sb.st_size > 0)
+     map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+
+   if(map != MAP_FAILED)
+     {
+      data = (unsigned char *)map;
+      size = (uint32)sb.st_size;
+      pos = 0;
+      mapped = true;
+      return true;
+     }
+  }
+#endif
+
+ // no mapping available, fall back to reading the whole file once.
+ NuvieIOFileRead file;
+ if(file.open(filename) == false)
+   return false;
+
+ size = file.get_size();
+ pos = 0;
+ if(size == 0)
+   return true;
+
+ data = (unsigned char *)malloc(size);
+ if(data == NULL || file.readToBuf(data, size) == false)
+   {
+    DEBUG(0,LEVEL_ERROR,"NuvieIOMapped::open() reading %d bytes from '%s'\n",size,filename);
+    free(data);
+    data = NULL;
+    size = 0;
+    return false;
+   }
+ copied_data = true;
+
+ return true;
+}
+
+void NuvieIOMapped::close()
+{
+#ifndef WIN32
+ if(mapped && data != NULL)
+   munmap(data, size);
+#endif
+
+ if(mapped)
+   data = NULL;
+ mapped = false;
+
+ NuvieIOBuffer::close();
+ copied_data = false;
+}
@@ -87,4 +87,31 @@ class NuvieIOFileWrite : public NuvieIOFileRead
    uint32 write(NuvieIO *src);
 
 };
+
+/* Read-only view of a whole file. The file is memory-mapped where the
+ * platform allows it, otherwise it is read into memory once on open. Either
+ * way reads are served straight from memory and get_raw_data() gives callers
+ * the file contents without another copy.
+ */
+class NuvieIOMapped : public NuvieIOBuffer
+{
+ protected:
+ bool mapped; // data points at a mapping rather than a malloc'd copy
+
+ public:
+
+   NuvieIOMapped();
+   ~NuvieIOMapped();
+
+   bool open(const char *filename);
+   bool open(std::string filename) { return open(filename.c_str()); };
+
+   void close();
+
+   bool write1(uint8 src) { return false; };
+   bool write2(uint16 src) { return false; };
+   bool write4(uint32 src) { return false; };
+   uint32 writeBuf(const unsigned char *src, uint32 src_size) { return 0; };
+   uint32 write(NuvieIO *src) { return 0; };
+};
 #endif /* __NuvieIOFile_h__ */
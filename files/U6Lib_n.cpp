@@ -51,9 +51,9 @@ U6Lib_n::~U6Lib_n(void)
 // load u6lib from `filename'
 bool U6Lib_n::open(std::string &filename, uint8 size, uint8 type)
 {
- NuvieIOFileRead *file;
+ NuvieIOMapped *file;
 
- file = new NuvieIOFileRead();
+ file = new NuvieIOMapped();
 
  if(file->open(filename) == false)
    {
@@ -63,7 +63,12 @@ bool U6Lib_n::open(std::string &filename, uint8 size, uint8 type)
 
  del_data = true;
 
- return open((NuvieIO *)file, size, type);
+ if(open((NuvieIO *)file, size, type) == false)
+   return false;
+
+ lib_filename = filename;
+
+ return true;
 }
 
 
@@ -97,6 +102,7 @@ void U6Lib_n::close()
 
  data = NULL;
  del_data = false;
+ lib_filename.clear();
 
  num_offsets = 0;
 
@@ -172,6 +178,7 @@ unsigned char *U6Lib_n::get_item(uint32 item_number, unsigned char *ret_buf)
    lzw_buf = (unsigned char *)malloc(item->size);
    data->readToBuf(lzw_buf,item->size);
    lzw.decompress_buffer(lzw_buf, item->size, buf, item->uncomp_size);
+   free(lzw_buf);
   }
  else
  {
@@ -529,3 +536,256 @@ void U6Lib_n::write_item(uint32 item_number)
         data->seek(items[item_number].offset + 4);
     ((NuvieIOFileWrite *)data)->writeBuf(items[item_number].data, items[item_number].size);
 }
+
+
+// U6LibCache
+
+/* Never destroyed, items may still be released by the mixer during exit. */
+U6LibCache *U6LibCache::get_cache()
+{
+ static U6LibCache *cache = new U6LibCache();
+ return cache;
+}
+
+U6LibCache::U6LibCache() : released(false)
+{
+ budget = U6LIB_CACHE_DEFAULT_SIZE * 1024;
+ cached_bytes = 0;
+ mutex = SDL_CreateMutex();
+ hits = 0;
+ misses = 0;
+ evictions = 0;
+}
+
+U6LibCache::~U6LibCache()
+{
+ std::map<std::pair<std::string, uint32>, U6LibCacheItem *>::iterator i;
+
+ for(i = items.begin(); i != items.end(); i++)
+   {
+    free(i->second->data);
+    delete i->second;
+   }
+ SDL_DestroyMutex(mutex);
+}
+
+void U6LibCache::set_budget(uint32 bytes)
+{
+ SDL_LockMutex(mutex);
+ collect_released();
+ budget = bytes;
+ evict();
+ SDL_UnlockMutex(mutex);
+}
+
+// call with the cache locked
+U6LibCacheItem *U6LibCache::find_item(const std::string &filename, uint32 item_number)
+{
+ std::map<std::pair<std::string, uint32>, U6LibCacheItem *>::iterator i;
+
+ i = items.find(std::make_pair(filename, item_number));
+ if(i == items.end())
+   return NULL;
+
+ U6LibCacheItem *item = i->second;
+ if(item->in_lru)
+   {
+    lru.erase(item->lru_pos);
+    item->in_lru = false;
+   }
+ item->ref_count++;
+ hits++;
+
+ return item;
+}
+
+/* Read `item_number' from `lib' and decode it, without touching the cache.
+ * An LZW item that starts with a zero size is stored uncompressed after that
+ * dword.
+ */
+unsigned char *U6LibCache::read_item(U6Lib_n *lib, uint32 item_number, bool lzw_item, uint32 &size, bool &lzw_decoded)
+{
+ unsigned char *buf;
+
+ size = lib->get_item_size(item_number);
+ lzw_decoded = false;
+
+ buf = lib->get_item(item_number);
+ if(buf == NULL)
+   return NULL;
+
+ if(lzw_item == U6LIB_ITEM_LZW)
+   {
+    unsigned char *lzw_buf = buf;
+    uint32 lzw_size = size;
+
+    if(lzw_size > 4 && lzw_buf[0] == 0 && lzw_buf[1] == 0 && lzw_buf[2] == 0 && lzw_buf[3] == 0)
+      {
+       size = lzw_size - 4;
+       buf = (unsigned char *)malloc(size);
+       if(buf != NULL)
+         memcpy(buf, lzw_buf + 4, size);
+      }
+    else
+      {
+       U6Lzw lzw;
+       buf = lzw.decompress_buffer(lzw_buf, lzw_size, size);
+       lzw_decoded = true;
+      }
+    free(lzw_buf);
+   }
+
+ return buf;
+}
+
+/* Read and decode an item that wasn't cached, then keep it. The lock is
+ * dropped while reading, so another thread may have added the same item in
+ * the meantime; that copy is used instead. Call with the cache locked.
+ */
+U6LibCacheItem *U6LibCache::add_item(U6Lib_n *lib, uint32 item_number, bool lzw_item)
+{
+ unsigned char *buf;
+ uint32 size;
+ bool lzw_decoded;
+ U6LibCacheItem *item;
+
+ SDL_UnlockMutex(mutex);
+ buf = read_item(lib, item_number, lzw_item, size, lzw_decoded);
+ SDL_LockMutex(mutex);
+
+ if(buf == NULL)
+   return NULL;
+
+ item = find_item(lib->get_filename(), item_number);
+ if(item != NULL)
+   {
+    free(buf);
+    return item;
+   }
+
+ item = new U6LibCacheItem;
+ item->key = std::make_pair(lib->get_filename(), item_number);
+ item->data = buf;
+ item->size = size;
+ item->lzw_decoded = lzw_decoded;
+ item->ref_count = 1;
+ item->in_lru = false;
+
+ items[item->key] = item;
+ cached_bytes += size;
+ misses++;
+
+ evict();
+
+ return item;
+}
+
+/* Return item `item_number' of `lib' decoded, from the cache when possible.
+ * `lib' must have been opened from a file.
+ */
+U6LibCacheItem *U6LibCache::get_item(U6Lib_n *lib, uint32 item_number, bool lzw_item)
+{
+ U6LibCacheItem *item;
+
+ if(lib->get_filename().empty())
+   {
+    DEBUG(0,LEVEL_ERROR,"U6LibCache: library wasn't opened from a file\n");
+    return NULL;
+   }
+
+ SDL_LockMutex(mutex);
+ collect_released();
+ item = find_item(lib->get_filename(), item_number);
+ if(item == NULL)
+   item = add_item(lib, item_number, lzw_item);
+ SDL_UnlockMutex(mutex);
+
+ return item;
+}
+
+/* As above, only opening the library at `filename' (with 4 byte offsets)
+ * when the item isn't cached.
+ */
+U6LibCacheItem *U6LibCache::get_item(std::string &filename, uint32 item_number, bool lzw_item)
+{
+ U6LibCacheItem *item;
+
+ SDL_LockMutex(mutex);
+ collect_released();
+ item = find_item(filename, item_number);
+ SDL_UnlockMutex(mutex);
+ if(item != NULL)
+   return item;
+
+ U6Lib_n lib;
+ if(lib.open(filename, 4) == false)
+   return NULL;
+
+ SDL_LockMutex(mutex);
+ item = add_item(&lib, item_number, lzw_item);
+ SDL_UnlockMutex(mutex);
+
+ return item;
+}
+
+/* Drop a reference to `item'. Safe to call from any thread without blocking.
+ * The item isn't touched after its count drops, as it may be evicted from
+ * then on.
+ */
+void U6LibCache::release(U6LibCacheItem *item)
+{
+ if(item == NULL)
+   return;
+
+ if(item->ref_count.fetch_sub(1) == 1)
+   released = true;
+}
+
+/* Move items that lost their last reference since the last call into the
+ * LRU list. Counts only go up with the cache locked, so an unused item
+ * stays unused until find_item() takes it. Call with the cache locked.
+ */
+void U6LibCache::collect_released()
+{
+ std::map<std::pair<std::string, uint32>, U6LibCacheItem *>::iterator i;
+
+ if(released.exchange(false) == false)
+   return;
+
+ for(i = items.begin(); i != items.end(); i++)
+   {
+    U6LibCacheItem *item = i->second;
+    if(item->ref_count == 0 && !item->in_lru)
+      {
+       lru.push_front(item);
+       item->lru_pos = lru.begin();
+       item->in_lru = true;
+      }
+   }
+
+ evict();
+}
+
+// free unused items, oldest first, until the cache is within its budget.
+void U6LibCache::evict()
+{
+ while(cached_bytes > budget && !lru.empty())
+   {
+    U6LibCacheItem *item = lru.back();
+    lru.pop_back();
+    items.erase(item->key);
+    cached_bytes -= item->size;
+    free(item->data);
+    delete item;
+    evictions++;
+   }
+}
+
+void U6LibCache::print_stats()
+{
+ SDL_LockMutex(mutex);
+ collect_released();
+ DEBUG(0,LEVEL_DEBUGGING,"U6LibCache: %d hits, %d misses, %d evictions, %d items (%d of %d bytes)\n",
+       hits, misses, evictions, (uint32)items.size(), cached_bytes, budget);
+ SDL_UnlockMutex(mutex);
+}
@@ -25,8 +25,13 @@
  */
 #include <vector>
 #include <string>
+#include <list>
+#include <map>
+#include <atomic>
 #include <cstdio> /* FILE */
 
+#include "SDL.h"
+
 using std::string;
 //using std::vector;
 
@@ -51,6 +56,7 @@ class U6Lib_n
  U6LibItem *items;
  NuvieIO *data;
  bool del_data;
+ std::string lib_filename; // set when opened from a file, used by U6LibCache
 
 public:
    U6Lib_n();
@@ -61,6 +67,7 @@ public:
    void close();
    bool create(std::string &filename, uint8 size, uint8 type=NUVIE_GAME_U6);
    uint8 get_game_type() { return game_type;}
+   const std::string &get_filename() { return lib_filename; }
 
    unsigned char *get_item(uint32 item_number, unsigned char *buf=NULL); // read
    void set_item_data(uint32 item_number, unsigned char *src, uint32 src_len);
@@ -88,6 +95,69 @@ protected:
    uint32 calculate_num_offsets(bool skip4);
 };
 
+#define U6LIB_CACHE_DEFAULT_SIZE 4096 // KB, see config/general/asset_cache_size
+
+#define U6LIB_ITEM_RAW false
+#define U6LIB_ITEM_LZW true
+
+/* A decoded library item held by U6LibCache. The data must not be modified. */
+struct U6LibCacheItem
+{
+ std::pair<std::string, uint32> key; // library path and item number
+ unsigned char *data;
+ uint32 size;
+ bool lzw_decoded; // the library held it LZW compressed
+ std::atomic<uint32> ref_count; // only raised with the cache locked
+ bool in_lru;
+ std::list<U6LibCacheItem *>::iterator lru_pos; // only valid while in_lru
+};
+
+/* Process wide cache of decoded library items (portraits, speech samples,
+ * conversation scripts), keyed by library path and item number. Items are
+ * reference counted; every get_item() must be matched by a release(). Once
+ * unused items take more than the byte budget the least recently used ones
+ * are freed.
+ *
+ * release() never locks, as the mixer calls it from the audio thread. It
+ * only drops the count and flags the cache, and the next locked call moves
+ * unused items into the LRU list. Libraries are read and decoded with the
+ * lock released.
+ */
+class U6LibCache
+{
+ std::map<std::pair<std::string, uint32>, U6LibCacheItem *> items;
+ std::list<U6LibCacheItem *> lru; // unused items, most recently released first
+ std::atomic<bool> released; // an item lost its last reference since the last locked call
+ uint32 budget; // bytes
+ uint32 cached_bytes; // size of all items, used or not
+ SDL_mutex *mutex; // guards everything but ref_count and released
+
+ uint32 hits;
+ uint32 misses;
+ uint32 evictions;
+
+ public:
+   static U6LibCache *get_cache();
+
+   U6LibCache();
+   ~U6LibCache();
+
+   void set_budget(uint32 bytes);
+
+   U6LibCacheItem *get_item(U6Lib_n *lib, uint32 item_number, bool lzw_item=U6LIB_ITEM_LZW);
+   U6LibCacheItem *get_item(std::string &filename, uint32 item_number, bool lzw_item=U6LIB_ITEM_LZW);
+   void release(U6LibCacheItem *item);
+
+   void print_stats();
+
+ protected:
+   U6LibCacheItem *find_item(const std::string &filename, uint32 item_number);
+   U6LibCacheItem *add_item(U6Lib_n *lib, uint32 item_number, bool lzw_item);
+   unsigned char *read_item(U6Lib_n *lib, uint32 item_number, bool lzw_item, uint32 &size, bool &lzw_decoded);
+   void collect_released();
+   void evict();
+};
+
 #if 0
 class U6ConverseLib: U6Lib_n
 {
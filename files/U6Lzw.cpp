@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include <string>
 
@@ -21,53 +22,145 @@
 
 U6Lzw::U6Lzw()
 {
- dict = new U6LzwDict;
- stack = new U6LzwStack;
+ // the roots are single bytes and never change, entries above 0x101 are
+ // filled in as they are decoded.
+ for(uint32 i = 0; i < 0x100; i++)
+   {
+    dict_prefix[i] = 0;
+    dict_suffix[i] = (unsigned char)i;
+    dict_first[i] = (unsigned char)i;
+    dict_length[i] = 1;
+   }
  errstr = "unknown error";
 }
 
 U6Lzw::~U6Lzw()
 {
- delete dict;
- delete stack;
 }
 
 
-/* Copy and return the contents of `src' buffer, in LZW form. It is not really
- * compressed, it just makes it suitable to be read by an LZW decoder.
+/* Return `src' compressed in U6 LZW form, with the 4 byte uncompressed size
+ * in front, or NULL if memory runs out. The dictionary is restarted with
+ * 0x100 before it outgrows 12 bit codewords.
  */
 unsigned char *U6Lzw::compress_buffer(unsigned char *src, uint32 src_len,
                                       uint32 &dest_len)
 {
-    // FIXME - didnt bother fixing this since its output will be larger than
-    //         the uncompressed data
-    uint32 blocks = 0; //, block = 0, b = 0, d = 0, rshift = 0;
-    //uint16 val = 0;
-    //unsigned char *dest_pt = NULL;
-    unsigned char *dest_buf = (unsigned char *)malloc(4);
+    const uint32 hash_size = 8192; // power of two, about twice the dictionary
+    uint32 *hash_key; // (prefix codeword << 8 | byte) + 1 of each entry, 0 if free
+    uint16 *hash_codeword;
+    unsigned char *dest_buf;
+    uint32 max_len;
+    uint32 i;
+
+    // writer state, mirroring the codeword size the decoder will be using
+    uint64_t bit_buffer = 0;
+    uint32 bits_held = 0;
+    uint32 codeword_size = 9;
+    uint32 dictionary_size = 0x200;
+    uint32 next_free_codeword = 0x102; // as seen by the decoder
+    bool first_codeword = true; // the decoder doesn't add an entry for it
+
+    uint32 next_codeword = 0x102; // next entry in our own dictionary
+    uint32 w; // codeword for the string matched so far
+
+    dest_len = 0;
+
+    // at most one 12 bit codeword per byte, plus the restarts and end marker.
+    max_len = 4 + (uint32)(((uint64_t)src_len + src_len / 3000 + 8) * 12 / 8) + 8;
+    dest_buf = (unsigned char *)malloc(max_len);
+    hash_key = (uint32 *)malloc(hash_size * sizeof(uint32));
+    hash_codeword = (uint16 *)malloc(hash_size * sizeof(uint16));
+    if(dest_buf == NULL || hash_key == NULL || hash_codeword == NULL)
+    {
+        free(dest_buf);
+        free(hash_key);
+        free(hash_codeword);
+        errstr = "compress_buffer: out of memory";
+        return NULL;
+    }
+    memset(hash_key, 0, hash_size * sizeof(uint32));
+
     // add 4 byte uncompressed length value
+    dest_buf[0] = src_len & 0xff;
+    dest_buf[1] = (src_len >> 8) & 0xff;
+    dest_buf[2] = (src_len >> 16) & 0xff;
+    dest_buf[3] = (src_len >> 24) & 0xff;
     dest_len = 4;
-    memcpy(dest_buf, &src_len, dest_len);
-    blocks = (src_len / 64);
-    if((blocks * 64) < src_len)
-        blocks += 1;
-    dest_buf = (unsigned char *)nuvie_realloc(dest_buf, src_len + 4);
-    dest_len = src_len + 4;
-    memset(&dest_buf[4], 0, src_len);
-#if 0
-    for(block = 0, d = 4; block < blocks && b < src_len; block++)
+
+#define U6LZW_PUT_CODEWORD(c) \
+    { \
+        bit_buffer |= (uint64_t)(c) << bits_held; \
+        bits_held += codeword_size; \
+        while(bits_held >= 8) \
+        { \
+            dest_buf[dest_len++] = (unsigned char)bit_buffer; \
+            bit_buffer >>= 8; \
+            bits_held -= 8; \
+        } \
+        if((c) == 0x100) \
+        { \
+            codeword_size = 9; \
+            dictionary_size = 0x200; \
+            next_free_codeword = 0x102; \
+            first_codeword = true; \
+        } \
+        else if(first_codeword) \
+            first_codeword = false; \
+        else if(++next_free_codeword >= dictionary_size && codeword_size < 12) \
+        { \
+            codeword_size++; \
+            dictionary_size *= 2; \
+        } \
+    }
+
+    U6LZW_PUT_CODEWORD(0x100);
+
+    if(src_len > 0)
     {
-        dest_len += 128;
-        dest_buf = (unsigned char *)realloc(dest_buf, dest_len);
-        // add 9 bit value 0x100
-//        rshift += (rshift < 7) ? 1 : -rshift;
-        for(; b < src_len; b++)
+        w = src[0];
+        for(i = 1; i < src_len; i++)
         {
-            // for each byte in block, add 9bit value, upper bit = 0
+            unsigned char c = src[i];
+            uint32 key = ((w << 8) | c) + 1;
+            uint32 h = (key * 2654435761U) >> 19; // 13 bit hash
+            while(hash_key[h] != 0 && hash_key[h] != key)
+                h = (h + 1) & (hash_size - 1);
+
+            if(hash_key[h] == key) // w+c is known, keep extending the match
+            {
+                w = hash_codeword[h];
+                continue;
+            }
+
+            U6LZW_PUT_CODEWORD(w);
+
+            if(next_codeword >= U6LZW_DICT_SIZE - 1)
+            {
+                // dictionary is full, start again
+                U6LZW_PUT_CODEWORD(0x100);
+                memset(hash_key, 0, hash_size * sizeof(uint32));
+                next_codeword = 0x102;
+            }
+            else
+            {
+                hash_key[h] = key;
+                hash_codeword[h] = next_codeword++;
+            }
+            w = c;
         }
+        U6LZW_PUT_CODEWORD(w);
     }
-    // add 9 bit value 0x101
-#endif
+
+    U6LZW_PUT_CODEWORD(0x101);
+#undef U6LZW_PUT_CODEWORD
+
+    if(bits_held > 0)
+        dest_buf[dest_len++] = (unsigned char)bit_buffer;
+
+    free(hash_key);
+    free(hash_codeword);
+
     return(dest_buf);
 }
 
@@ -140,8 +233,8 @@ long U6Lzw::get_uncompressed_buffer_size(unsigned char *buf, uint32 length)
 
  // -----------------------------------------------------------------------------
  // LZW-decompress from buffer to buffer.
- // The parameters "source_length" and "destination_length" are currently unused.
- // They might be used to prevent reading/writing outside the buffers.
+ // Reads never go past "source_length" and writes never go past
+ // "destination_length".
  // -----------------------------------------------------------------------------
 
 unsigned char *U6Lzw::decompress_buffer(unsigned char *source, uint32 source_length, uint32 &destination_length)
@@ -166,104 +259,135 @@ unsigned char *U6Lzw::decompress_buffer(unsigned char *source, uint32 source_len
  return destination;
 }
 
+/* Codewords are read through a 64 bit bit buffer, and each string is written
+ * straight into `destination' from its last byte back to its first by walking
+ * the prefix chain, so no stack is needed.
+ */
 bool U6Lzw::decompress_buffer(unsigned char *source, uint32 source_length, unsigned char *destination, uint32 destination_length)
 {
-    const int max_codeword_length = 12;
-    bool end_marker_reached = false;
-    int codeword_size = 9;
-    long bits_read = 0;
-    int next_free_codeword = 0x102;
-    int dictionary_size = 0x200;
+    const uint32 max_codeword_length = 12;
+    uint32 codeword_size = 9;
+    uint32 codeword_mask = 0x1ff;
+    uint32 next_free_codeword = 0x102;
+    uint32 dictionary_size = 0x200;
+    bool read_root = false; // the codeword after 0x100 is a plain byte
 
-    long bytes_written = 0;
+    const unsigned char *src, *src_end;
+    uint64_t bit_buffer = 0;
+    uint32 bits_held = 0;
 
-    int cW;
-    int pW = 0;  // get rid of uninitialized warning.
-    unsigned char C;
+    uint32 bytes_written = 0;
 
-    source += 4; //skip the filesize dword.
+    uint32 cW;
+    uint32 pW = 0;
 
-    while (! end_marker_reached)
+    if(source_length < 4)
     {
-       cW = get_next_codeword(&bits_read, source, codeword_size);
-       switch (cW)
+       errstr = "decompress_buffer: source too short";
+       return false;
+    }
+
+    src = source + 4; //skip the filesize dword.
+    src_end = source + source_length;
+
+    for(;;)
+    {
+       // top up the bit buffer. Anything past the end of the source reads as 0.
+       if(bits_held < max_codeword_length)
        {
+          for(; bits_held <= 56; bits_held += 8)
+             bit_buffer |= (uint64_t)(src < src_end ? *src++ : 0) << bits_held;
+       }
+       cW = (uint32)bit_buffer & codeword_mask;
+       bit_buffer >>= codeword_size;
+       bits_held -= codeword_size;
+
        // re-init the dictionary
-       case 0x100:
-           codeword_size = 9;
-           next_free_codeword = 0x102;
-           dictionary_size = 0x200;
-           dict->reset();
-           cW = get_next_codeword(&bits_read, source, codeword_size);
-           output_root((unsigned char)cW, destination, &bytes_written);
-           break;
+       if(cW == 0x100)
+       {
+          codeword_size = 9;
+          codeword_mask = 0x1ff;
+          next_free_codeword = 0x102;
+          dictionary_size = 0x200;
+          read_root = true;
+          continue;
+       }
        // end of compressed file has been reached
-       case 0x101:
-           end_marker_reached = true;
-           break;
-       // (cW <> 0x100) && (cW <> 0x101)
-       default:
-           if (cW < next_free_codeword)  // codeword is already in the dictionary
-           {
-              // create the string associated with cW (on the stack)
-              get_string(cW);
-              C = stack->gettop();
-              // output the string represented by cW
-              while (!stack->is_empty())
-              {
-                 output_root(stack->pop(), destination, &bytes_written);
-              }
-              // add pW+C to the dictionary
-              dict->add(C,pW);
-
-              next_free_codeword++;
-              if (next_free_codeword >= dictionary_size)
-              {
-                 if (codeword_size < max_codeword_length)
-                 {
-                    codeword_size += 1;
-                    dictionary_size *= 2;
-                 }
-              }
-           }
-           else  // codeword is not yet defined
-           {
-              // create the string associated with pW (on the stack)
-              get_string(pW);
-              C = stack->gettop();
-              // output the string represented by pW
-              while (!stack->is_empty())
-              {
-                 output_root(stack->pop(), destination, &bytes_written);
-              }
-              // output the char C
-              output_root(C, destination, &bytes_written);
-              // the new dictionary entry must correspond to cW
-              // if it doesn't, something is wrong with the lzw-compressed data.
-              if (cW != next_free_codeword)
-              {
-                 DEBUG(0,LEVEL_ERROR,"cW != next_free_codeword!\n");
-                 return(false);
-              }
-              // add pW+C to the dictionary
-              dict->add(C,pW);
-
-              next_free_codeword++;
-              if (next_free_codeword >= dictionary_size)
-              {
-                 if (codeword_size < max_codeword_length)
-                 {
-                    codeword_size += 1;
-                    dictionary_size *= 2;
-                 }
-              }
-           };
-           break;
+       if(cW == 0x101)
+          break;
+
+       if(read_root)
+       {
+          if(bytes_written >= destination_length)
+             break;
+          destination[bytes_written++] = (unsigned char)cW;
+          read_root = false;
+          pW = cW;
+          continue;
+       }
+
+       uint32 string_cW; // codeword whose string is output
+       uint32 length;
+       unsigned char C; // first byte of the output
+
+       if(cW < next_free_codeword) // codeword is already in the dictionary
+       {
+          string_cW = cW;
+          length = dict_length[cW];
+          C = dict_first[cW];
+       }
+       else // codeword is not yet defined, it must be pW+C
+       {
+          // the new dictionary entry must correspond to cW
+          // if it doesn't, something is wrong with the lzw-compressed data.
+          if(cW != next_free_codeword)
+          {
+             DEBUG(0,LEVEL_ERROR,"cW != next_free_codeword!\n");
+             return(false);
+          }
+          string_cW = pW;
+          length = dict_length[pW] + 1;
+          C = dict_first[pW];
+       }
+
+       if(length > destination_length - bytes_written)
+          break;
+
+       unsigned char *out = &destination[bytes_written + dict_length[string_cW] - 1];
+       if(string_cW != cW)
+          out[1] = C;
+       for(; string_cW > 0xff; string_cW = dict_prefix[string_cW])
+          *out-- = dict_suffix[string_cW];
+       *out = (unsigned char)string_cW;
+       bytes_written += length;
+
+       // add pW+C to the dictionary
+       if(next_free_codeword < U6LZW_DICT_SIZE)
+       {
+          dict_prefix[next_free_codeword] = pW;
+          dict_suffix[next_free_codeword] = C;
+          dict_first[next_free_codeword] = dict_first[pW];
+          dict_length[next_free_codeword] = dict_length[pW] + 1;
+       }
+
+       next_free_codeword++;
+       if(next_free_codeword >= dictionary_size && codeword_size < max_codeword_length)
+       {
+          codeword_size += 1;
+          codeword_mask = (codeword_mask << 1) | 1;
+          dictionary_size *= 2;
        }
        // shift roles - the current cW becomes the new pW
        pW = cW;
     }
 
+ if(cW != 0x101)
+   {
+    errstr = "decompress_buffer: output is larger than the destination buffer";
+    DEBUG(0,LEVEL_ERROR,"U6Lzw: %s\n", errstr);
+    return false;
+   }
+
  return true;
 }
 
@@ -320,165 +444,3 @@ unsigned char *U6Lzw::decompress_file(std::string filename, uint32 &destination_
 
  return destination_buffer;
 }
-
- // ----------------------------------------------
- // Read the next code word from the source buffer
- // ----------------------------------------------
-int U6Lzw::get_next_codeword (long *bits_read, unsigned char *source, int codeword_size)
-{
-    unsigned char b0,b1,b2;
-    int codeword;
-
-    b0 = source[*bits_read/8];
-    b1 = source[*bits_read/8+1];
-    if (codeword_size + (*bits_read % 8) > 16)
-      b2 = source[*bits_read/8+2]; // only read next byte if necessary
-    else
-      b2 = 0;
-
-    codeword = ((b2 << 16) + (b1 << 8) + b0);
-    codeword = codeword >> (*bits_read % 8);
-    switch (codeword_size)
-    {
-     case 0x9:
-         codeword = codeword & 0x1ff;
-         break;
-     case 0xa:
-         codeword = codeword & 0x3ff;
-         break;
-     case 0xb:
-         codeword = codeword & 0x7ff;
-         break;
-     case 0xc:
-         codeword = codeword & 0xfff;
-         break;
-     default:
-         DEBUG(0,LEVEL_ERROR,"U6Lzw Error: weird codeword size!\n");
-         break;
-    }
-    *bits_read += codeword_size;
-
-    return (codeword);
-}
-
-void U6Lzw::output_root(unsigned char root, unsigned char *destination, long *position)
-{
-    destination[*position] = root;
-    *position = *position + 1;
-}
-
-void U6Lzw::get_string(int codeword)
-{
-    unsigned char root;
-    int current_codeword;
-
-    current_codeword = codeword;
-    stack->reset();
-    while (current_codeword > 0xff)
-    {
-       root = dict->get_root(current_codeword);
-       current_codeword = dict->get_codeword(current_codeword);
-       stack->push(root);
-    }
-
-    // push the root at the leaf
-    stack->push((unsigned char)current_codeword);
-}
-
-
-U6LzwStack::U6LzwStack()
-{
- memset(stack, 0, STACK_SIZE);
- this->reset();
-}
-
-void U6LzwStack::reset(void)
-{
- contains = 0;
-}
-
-bool U6LzwStack::is_empty(void)
-{
- if(contains == 0)
-   return true;
-
- return false;
-}
-
-bool U6LzwStack::is_full(void)
-{
- if(contains==STACK_SIZE)
-    return true;
-
- return false;
-}
-
-void U6LzwStack::push(unsigned char element)
-{
- if(!this->is_full())
-   {
-    stack[contains] = element;
-    contains++;
-   }
-}
-
-unsigned char U6LzwStack::pop(void)
-{
- unsigned char element;
-
- if(!this->is_empty())
- {
-  element = stack[contains-1];
-  contains--;
- }
-  else
- {
-  element = 0;
- }
- return(element);
-}
-
-unsigned char U6LzwStack::gettop(void)
-{
- if(!this->is_empty())
-   {
-    return(stack[contains-1]);
-   }
-
- return '\0'; /* what should we return here!? */
-}
-
-/*
-   --------------------------------------------------
-   a dictionary class
-   --------------------------------------------------
-*/
-
-U6LzwDict::U6LzwDict()
-{
- this->reset();
- memset(&dict, 0, sizeof(dict));
-}
-
-void U6LzwDict::reset(void)
-{
- contains = 0x102;
-}
-
-void U6LzwDict::add(unsigned char root, int codeword)
-{
- dict[contains].root = root;
- dict[contains].codeword = codeword;
- contains++;
-}
-
-unsigned char U6LzwDict::get_root(int codeword)
-{
- return (dict[codeword].root);
-}
-
-int U6LzwDict::get_codeword(int codeword)
-{
- return (dict[codeword].codeword);
-}
-
@@ -37,6 +37,7 @@
 #include "Background.h"
 #include "Configuration.h"
 #include "U6misc.h"
+#include "Script.h"
 
 #define GAME Game::get_game()
 #define EVENT Game::get_game()->get_event()
@@ -527,6 +528,11 @@ void ActionIncreaseDebug(int const *params)
 	DEBUG(0,LEVEL_EMERGENCY,"!!increase!!\n");
 }
 
+void ActionShowScriptStats(int const *params)
+{
+	GAME->get_script()->print_gc_stats();
+}
+
 void ActionCloseGumps(int const *params)
 {
 	EVENT->close_gumps();
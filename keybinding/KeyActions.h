@@ -80,6 +80,7 @@ void ActionMsgScrollDown(int const *params);
 void ActionShowKeys(int const *params);
 void ActionDecreaseDebug(int const *params);
 void ActionIncreaseDebug(int const *params);
+void ActionShowScriptStats(int const *params);
 void ActionCloseGumps(int const *params);
 void ActionUseItem(int const *params);
 
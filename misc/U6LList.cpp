@@ -21,10 +21,122 @@
  *
  */
 
+#include <stdlib.h>
+
 #include "nuvieDefs.h"
 
 #include "U6LList.h"
 
+U6Pool::U6Pool(const char *pool_name, uint32 size, uint32 per_page)
+{
+ name = pool_name;
+ // every item must be able to hold the free list pointer, and stay aligned.
+ item_size = (size + sizeof(void *) - 1) & ~(uint32)(sizeof(void *) - 1);
+ if(item_size < sizeof(void *))
+   item_size = sizeof(void *);
+ items_per_page = per_page;
+ page_n = 0;
+ page_used = 0;
+ free_list = NULL;
+ live = 0;
+ peak = 0;
+ total_allocs = 0;
+}
+
+U6Pool::~U6Pool()
+{
+ for(uint32 i = 0; i < pages.size(); i++)
+   free(pages[i]);
+}
+
+void *U6Pool::alloc()
+{
+ void *ptr;
+
+ if(free_list != NULL)
+   {
+    ptr = free_list;
+    free_list = *(void **)ptr;
+   }
+ else
+   {
+    if(page_n < pages.size() && page_used == items_per_page)
+      {
+       page_n++;
+       page_used = 0;
+      }
+    if(page_n == pages.size())
+      {
+       unsigned char *page = (unsigned char *)malloc(item_size * items_per_page);
+       if(page == NULL)
+         {
+          DEBUG(0,LEVEL_ERROR,"U6Pool(%s): allocating page %d\n",name,page_n);
+          return NULL;
+         }
+       pages.push_back(page);
+      }
+    ptr = &pages[page_n][page_used * item_size];
+    page_used++;
+   }
+
+ live++;
+ total_allocs++;
+ if(live > peak)
+   peak = live;
+
+ return ptr;
+}
+
+void U6Pool::release(void *ptr)
+{
+ if(ptr == NULL)
+   return;
+
+ *(void **)ptr = free_list;
+ free_list = ptr;
+ live--;
+}
+
+/* Drop the free list and start carving from the first page again, so the
+ * next load gets its items back in allocation order. Only possible when
+ * nothing allocated from the pool is still alive.
+ */
+bool U6Pool::reset_if_empty()
+{
+ if(live != 0)
+   return false;
+
+ free_list = NULL;
+ page_n = 0;
+ page_used = 0;
+
+ return true;
+}
+
+void U6Pool::print_stats()
+{
+ DEBUG(0,LEVEL_DEBUGGING,"U6Pool(%s): %d live, %d peak, %d allocations, %d pages (%d bytes)\n",
+       name, live, peak, total_allocs, (uint32)pages.size(), (uint32)pages.size() * items_per_page * item_size);
+}
+
+/* The pool is never destroyed, as U6Lists in static objects may still free
+ * their links during exit. */
+U6Pool *U6Link::get_pool()
+{
+ static U6Pool *pool = new U6Pool("U6Link", sizeof(U6Link), U6LINK_POOL_PAGE_SIZE);
+ return pool;
+}
+
+void *U6Link::operator new(size_t size) noexcept
+{
+ return get_pool()->alloc();
+}
+
+void U6Link::operator delete(void *ptr)
+{
+ get_pool()->release(ptr);
+}
+
 void retainU6Link(U6Link *link)
 {
 	if(link)
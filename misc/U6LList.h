@@ -25,10 +25,44 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
+#include <vector>
 
 #define U6LLIST_FREE_DATA true
 
+#define U6LINK_POOL_PAGE_SIZE 1024 // links allocated at once by the link pool
 
+/* Fixed size allocator for the small engine objects that are created in bulk
+ * when a map or savegame is loaded (U6Link, Obj). Items are carved out of
+ * pages which are kept for the life of the program, and freed items go on a
+ * free list for reuse. Once every item has been freed the pool rewinds to the
+ * start of its first page.
+ */
+class U6Pool
+{
+ const char *name;
+ uint32 item_size;
+ uint32 items_per_page;
+ std::vector<unsigned char *> pages;
+ uint32 page_n; // page items are currently carved from
+ uint32 page_used; // items carved from that page so far
+ void *free_list;
+
+ uint32 live; // items handed out and not yet freed
+ uint32 peak;
+ uint32 total_allocs;
+
+ public:
+
+ U6Pool(const char *pool_name, uint32 size, uint32 per_page);
+ ~U6Pool();
+
+ void *alloc();
+ void release(void *ptr);
+
+ bool reset_if_empty();
+ void print_stats();
+};
 
 struct U6Link
 {
@@ -37,6 +71,10 @@ struct U6Link
  void *data;
  uint8 ref_count;
  U6Link() {next = NULL; prev = NULL; data = NULL; ref_count = 1;}
+
+ static void *operator new(size_t size) noexcept;
+ static void operator delete(void *ptr);
+ static U6Pool *get_pool();
 };
 
 void retainU6Link(U6Link *link);
@@ -2,9 +2,23 @@
 #include "nuvieDefs.h"
 #include "DirFinder.h"
 #include "AStarPath.h"
-AStarPath::AStarPath() : final_node(0)
-{}void AStarPath::create_path()
-{    astar_node *i = final_node; // iterator through steps, from back
+
+AStarPath::AStarPath() : nodes_used(0), open_count(0), final_node(0)
+{
+}
+
+AStarPath::~AStarPath()
+{
+    while(!node_blocks.empty())
+    {
+        delete [] node_blocks.back();
+        node_blocks.pop_back();
+    }
+}
+
+void AStarPath::create_path()
+{
+    astar_node *i = final_node; // iterator through steps, from back
     delete_path();
     std::vector<astar_node *> reverse_list;
     while(i)
@@ -19,71 +33,74 @@ AStarPath::AStarPath() : final_node(0)
         reverse_list.pop_back();
     }
     set_path_size(step_count);
-}/* Get a new neighbor to nnode and score it, returning true if it's usable. */
-bool AStarPath::score_to_neighbor(sint8 dir, astar_node *nnode, astar_node *neighbor,
+}
+
+/* Get the location of a neighbor to nnode and the cost of moving there,
+ * returning true if it's usable. */
+bool AStarPath::score_to_neighbor(sint8 dir, astar_node *nnode, MapCoord &neighbor_loc,
                                   sint32 &nnode_to_neighbor)
-{    sint8 sx = -1, sy = -1;
+{
+    sint8 sx = -1, sy = -1;
     DirFinder::get_adjacent_dir(sx, sy, dir); // sx,sy = neighbor -1,-1 + dir
     // get neighbor of nnode towards sx,sy, and cost to that neighbor
-    neighbor->loc = nnode->loc.abs_coords(sx, sy);
-    nnode_to_neighbor = step_cost(nnode->loc, neighbor->loc);
+    neighbor_loc = nnode->loc.abs_coords(sx, sy);
+    nnode_to_neighbor = step_cost(nnode->loc, neighbor_loc);
     if(nnode_to_neighbor == -1)
-    {
-        delete neighbor; // this neighbor is blocked
-        return false;
-    }
+        return false; // this neighbor is blocked
     return true;
-}/* Compare a node's score to the start node to already scored neighbors. */
-bool AStarPath::compare_neighbors(astar_node *nnode, astar_node *neighbor,
-                                  sint32 nnode_to_neighbor, astar_node *in_open,
-                                  astar_node *in_closed)
-{    neighbor->to_start = nnode->to_start + nnode_to_neighbor;
-     // ignore this neighbor if already checked and closer to start
-    if((in_open && in_open->to_start <= neighbor->to_start)
-       || (in_closed && in_closed->to_start <= neighbor->to_start))
-    {
-        delete neighbor;
-        return false;
-    }
-    return true;
-}/* Check all neighbors of a node (location) and save them to the "seen" list. */
+}
+
+/* Check all neighbors of a node (location) and open the ones that are new or
+ * have been reached by a shorter route. */
 bool AStarPath::search_node_neighbors(astar_node *nnode, MapCoord &goal,
                                       const uint32 max_score)
-{    for(uint32 dir = 1; dir < 8; dir += 2)
+{
+    for(uint32 dir = 1; dir < 8; dir += 2)
     {
-        astar_node *neighbor = new astar_node;
+        MapCoord neighbor_loc;
         sint32 nnode_to_neighbor = -1;
-        if(!score_to_neighbor(dir, nnode, neighbor, nnode_to_neighbor))
+        if(!score_to_neighbor(dir, nnode, neighbor_loc, nnode_to_neighbor))
             continue; // this neighbor is blocked
-        astar_node *in_open = find_open_node(neighbor),
-                   *in_closed = find_closed_node(neighbor);
-        if(!compare_neighbors(nnode, neighbor, nnode_to_neighbor, in_open, in_closed))
+
+        uint32 to_start = nnode->to_start + nnode_to_neighbor;
+        astar_node *neighbor = find_node(neighbor_loc);
+        // ignore this neighbor if already checked and closer to start
+        if(neighbor && neighbor->to_start <= to_start)
             continue;
+
+        uint32 to_goal = path_cost_est(neighbor_loc, goal);
+        if(to_start + to_goal > max_score)
+            continue; // too far away
+
+        bool seen = (neighbor != NULL);
+        if(!seen)
+            neighbor = new_node(neighbor_loc);
         neighbor->parent = nnode;
-        neighbor->to_goal = path_cost_est(neighbor->loc, goal);
-        neighbor->score = neighbor->to_start + neighbor->to_goal;
+        neighbor->to_start = to_start;
+        neighbor->to_goal = to_goal;
+        neighbor->score = to_start + to_goal;
         neighbor->len = nnode->len + 1;
-        if(neighbor->score > max_score)
-        {
-            delete neighbor; // too far away
-            continue;
-        }
-        // take neighbor out of closed list and put into open list
-        if(in_closed)
-            remove_closed_node(in_closed);
-        if(!in_open)
+
+        // take neighbor out of closed set and put into open set, or just
+        // move it up in the open set if it was already there
+        if(seen && !neighbor->closed)
+            update_open_node(neighbor);
+        else
             push_open_node(neighbor);
     }
     return true;
-}/* Do A* search of tiles to create a path from `start' to `goal'.
+}
+
+/* Do A* search of tiles to create a path from `start' to `goal'.
  * Don't search past nodes with a score over the max. score.
  * Create a partial path to low-score nodes with a distance-to-start over the
  * max_steps count, defined here. Actor may perform another search when needed.
  * Returns true if a path is created
- */bool AStarPath::path_search(MapCoord &start, MapCoord &goal)
-{//DEBUG(0,LEVEL_DEBUGGING,"SEARCH: %d: %d,%d -> %d,%d\n",actor->get_actor_num(),start.x,start.y,goal.x,goal.y);
-    astar_node *start_node = new astar_node;
-    start_node->loc = start;
+ */
+bool AStarPath::path_search(MapCoord &start, MapCoord &goal)
+{
+//DEBUG(0,LEVEL_DEBUGGING,"SEARCH: %d: %d,%d -> %d,%d\n",actor->get_actor_num(),start.x,start.y,goal.x,goal.y);
+    astar_node *start_node = new_node(start);
     start_node->to_start = 0;
     start_node->to_goal = path_cost_est(start, goal);
     start_node->score = start_node->to_start + start_node->to_goal;
@@ -91,13 +108,13 @@ bool AStarPath::search_node_neighbors(astar_node *nnode, MapCoord &goal,
     push_open_node(start_node);
     const uint32 max_score = get_max_score(start_node->to_goal);
     const uint32 max_steps = 8*2*4; // walk up to four screen lengths before searching again
-    while(!open_nodes.empty())
+    while(!open_heap.empty())
     {
         astar_node *nnode = pop_open_node(); // next closest
         if(nnode->loc == goal || nnode->len >= max_steps)
         {
-	    if(nnode->loc != goal)
-	        DEBUG(0,LEVEL_DEBUGGING,"out of steps, making partial path (nnode->len=%d)\n",nnode->len);
+            if(nnode->loc != goal)
+                DEBUG(0,LEVEL_DEBUGGING,"out of steps, making partial path (nnode->len=%d)\n",nnode->len);
 //DEBUG(0,LEVEL_DEBUGGING,"GOAL\n");
             final_node = nnode;
             create_path();
@@ -107,80 +124,139 @@ bool AStarPath::search_node_neighbors(astar_node *nnode, MapCoord &goal,
         // check cardinal neighbors (starting at top going clockwise)
         search_node_neighbors(nnode, goal, max_score);
         // node and neighbors checked, put into closed
-        closed_nodes.push_back(nnode);
+        nnode->closed = true;
     }
 //DEBUG(0,LEVEL_DEBUGGING,"FAIL\n");
     delete_nodes();
     return(false); // out of open nodes - failure
-}/* Return the cost of moving one step from `c1' to `c2', which is always 1. This
+}
+
+/* Return the cost of moving one step from `c1' to `c2', which is always 1. This
  * isn't very helpful, so subclasses should provide their own function.
  * Returns -1 if c2 is blocked. */
 sint32 AStarPath::step_cost(MapCoord &c1, MapCoord &c2)
-{    if(!pf->check_loc(c2.x, c2.y, c2.z)
+{
+    if(!pf->check_loc(c2.x, c2.y, c2.z)
        || c2.distance(c1) > 1)
             return(-1);
     return(1);
-}/* Return an item in the list of closed nodes whose location matches `ncmp'.
- */astar_node *AStarPath::find_closed_node(astar_node *ncmp)
-{    std::list<astar_node *>::iterator n;
-    for(n = closed_nodes.begin(); n != closed_nodes.end(); n++)
-        if((*n)->loc == ncmp->loc)
-            return(*n);
-    return(NULL);
-}/* Return an item in the list of closed nodes whose location matches `ncmp'.
- */astar_node *AStarPath::find_open_node(astar_node *ncmp)
-{    std::list<astar_node *>::iterator n;
-    for(n = open_nodes.begin(); n != open_nodes.end(); n++)
-        if((*n)->loc == ncmp->loc)
-            return(*n);
-    return(NULL);
-}/* Add new node pointer to the list of open nodes (sorting by score).
- */void AStarPath::push_open_node(astar_node *node)
-{    std::list<astar_node *>::iterator n, next;
-    if(open_nodes.empty())
-    {
-        open_nodes.push_front(node);
-        return;
-    }
-    n = open_nodes.begin();
-    // get to end of list or to a node with equal or greater score
-    while(n != open_nodes.end() && (*n++)->score < node->score);
-    open_nodes.insert(n, node); // and add before that location
-}/* Return pointer to the highest priority node from the list of open nodes, and
- * remove it.
- */astar_node *AStarPath::pop_open_node()
-{    astar_node *best = open_nodes.front();
-    open_nodes.pop_front(); // remove it
-    return(best);
 }
 
-/* Find item in the list of closed nodes whose location matched `ncmp', and
- * remove it from the list.
+/* Take a cleared node for `loc' from the node pool, and index it by location.
+ * The pool only grows, so a search allocates nothing once it is large enough.
  */
-void AStarPath::remove_closed_node(astar_node *ncmp)
+astar_node *AStarPath::new_node(MapCoord &loc)
 {
-    std::list<astar_node *>::iterator n;
-    for(n = closed_nodes.begin(); n != closed_nodes.end(); n++)
-        if((*n)->loc == ncmp->loc)
-        {
-            closed_nodes.erase(n);
-            return;
-        }
+    uint32 block = nodes_used / ASTAR_NODE_BLOCK_SIZE;
+    if(block >= node_blocks.size())
+        node_blocks.push_back(new astar_node[ASTAR_NODE_BLOCK_SIZE]);
+    astar_node *node = &node_blocks[block][nodes_used % ASTAR_NODE_BLOCK_SIZE];
+    ++nodes_used;
+
+    *node = astar_node();
+    node->loc = loc;
+    seen_nodes[node_key(loc)] = node;
+    return(node);
 }
 
-/* Delete nodes dereferenced from pointers in the lists.
+/* Return the open or closed node at location `loc', or NULL if it hasn't been
+ * seen in this search.
  */
-void AStarPath::delete_nodes()
-{    while(!open_nodes.empty())
+astar_node *AStarPath::find_node(MapCoord &loc)
+{
+    std::unordered_map<uint32, astar_node *>::iterator n = seen_nodes.find(node_key(loc));
+    if(n == seen_nodes.end())
+        return(NULL);
+    return(n->second);
+}
+
+/* Returns true if `n1' should be searched before `n2'. Nodes with equal scores
+ * are taken newest first.
+ */
+bool AStarPath::open_node_before(astar_node *n1, astar_node *n2)
+{
+    if(n1->score != n2->score)
+        return(n1->score < n2->score);
+    return(n1->order > n2->order);
+}
+
+/* Move the open node at heap position `i' up to its place. */
+void AStarPath::heap_up(uint32 i)
+{
+    astar_node *node = open_heap[i];
+    while(i > 0)
     {
-        astar_node *delnode = open_nodes.front();
-        open_nodes.pop_front();
-        delete delnode;
+        uint32 parent = (i - 1) / 2;
+        if(!open_node_before(node, open_heap[parent]))
+            break;
+        open_heap[i] = open_heap[parent];
+        open_heap[i]->heap_index = i;
+        i = parent;
     }
-    while(!closed_nodes.empty())
+    open_heap[i] = node;
+    node->heap_index = i;
+}
+
+/* Move the open node at heap position `i' down to its place. */
+void AStarPath::heap_down(uint32 i)
+{
+    uint32 size = open_heap.size();
+    astar_node *node = open_heap[i];
+    while(true)
     {
-        astar_node *delnode = closed_nodes.front();
-        closed_nodes.pop_front();
-        delete delnode;
+        uint32 child = i * 2 + 1;
+        if(child >= size)
+            break;
+        if(child + 1 < size && open_node_before(open_heap[child + 1], open_heap[child]))
+            ++child;
+        if(!open_node_before(open_heap[child], node))
+            break;
+        open_heap[i] = open_heap[child];
+        open_heap[i]->heap_index = i;
+        i = child;
     }
+    open_heap[i] = node;
+    node->heap_index = i;
+}
+
+/* Add node to the open nodes (sorting by score).
+ */
+void AStarPath::push_open_node(astar_node *node)
+{
+    node->closed = false;
+    node->order = ++open_count;
+    open_heap.push_back(node);
+    heap_up(open_heap.size() - 1);
+}
+
+/* Reposition an open node after its score has been lowered.
+ */
+void AStarPath::update_open_node(astar_node *node)
+{
+    node->order = ++open_count;
+    heap_up(node->heap_index);
+}
+
+/* Return pointer to the highest priority node from the open nodes, and
+ * remove it.
+ */
+astar_node *AStarPath::pop_open_node()
+{
+    astar_node *best = open_heap.front();
+    open_heap.front() = open_heap.back();
+    open_heap.pop_back(); // remove it
+    if(!open_heap.empty())
+        heap_down(0);
+    best->heap_index = -1;
+    return(best);
+}
+
+/* Forget all nodes from the last search, and return them to the pool.
+ */
+void AStarPath::delete_nodes()
+{
+    open_heap.clear();
+    seen_nodes.clear();
+    nodes_used = 0;
+    open_count = 0;
 }
@@ -21,6 +21,8 @@
  *
  */
 
+#include <cstring>
+
 #include "nuvieDefs.h"
 
 #include "Configuration.h"
@@ -33,7 +35,6 @@
 #include "ActorManager.h"
 #include "Actor.h"
 #include "PortraitU6.h"
-#include "U6Lzw.h"
 #include "U6misc.h"
 
 #include "U6objects.h"
@@ -129,10 +130,8 @@ uint8 PortraitU6::get_portrait_num(Actor *actor)
 
 unsigned char *PortraitU6::get_portrait_data(Actor *actor)
 {
- U6Lzw lzw;
  U6Lib_n *portrait;
- unsigned char *lzw_data;
- uint32 new_length;
+ U6LibCacheItem *item;
  unsigned char *new_portrait;
  uint8 num = get_portrait_num(actor);
  if(num == NO_PORTRAIT_FOUND)
@@ -153,11 +152,13 @@ unsigned char *PortraitU6::get_portrait_data(Actor *actor)
    }
  }
 
- lzw_data = portrait->get_item(num);
- if(!lzw_data)
+ item = U6LibCache::get_cache()->get_item(portrait, num);
+ if(!item)
    return NULL;
- new_portrait = lzw.decompress_buffer(lzw_data, portrait->get_item_size(num), new_length);
- free(lzw_data);
+ // the cached portrait is shared, so dither a copy of it.
+ new_portrait = (unsigned char *)malloc(item->size);
+ memcpy(new_portrait, item->data, item->size);
+ U6LibCache::get_cache()->release(item);
  Game::get_game()->get_dither()->dither_bitmap(new_portrait,PORTRAIT_WIDTH,PORTRAIT_HEIGHT,true);
 
  return new_portrait;
@@ -23,6 +23,13 @@
 
 #include <list>
 #include <cassert>
+#include <cstdio>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "SDL.h"
 
@@ -64,17 +71,25 @@
 SaveGame::SaveGame(Configuration *cfg)
 {
  config = cfg;
+ save_thread = NULL;
+ save_done = SDL_CreateSemaphore(0);
+ save_data = NULL;
+ save_ok = false;
  init(NULL); //we don't need ObjManager here as there will be nothing to clean at this stage. :-)
 }
 
 SaveGame::~SaveGame()
 {
+ wait_for_save(false); // the game is going away, just let the file be finished
+ SDL_DestroySemaphore(save_done);
  objlist.close();
  clean_up();
 }
 
 void SaveGame::init(ObjManager *obj_manager)
 {
+ wait_for_save(); // a load mustn't race the file still being written
+
  header.save_description.assign("");
 
  if(objlist.get_size() > 0)
@@ -147,16 +162,15 @@ bool SaveGame::load_new()
 bool SaveGame::load_original()
 {
  std::string path, objlist_filename, objblk_filename;
- unsigned char *data;
  //char *filename;
  char x,y;
  uint16 len;
  uint8 i;
- NuvieIOFileRead *objblk_file;
- NuvieIOFileRead objlist_file;
+ NuvieIOMapped *objblk_file;
+ NuvieIOMapped objlist_file;
  ObjManager *obj_manager;
 
- objblk_file = new NuvieIOFileRead();
+ objblk_file = new NuvieIOMapped();
 
  obj_manager = Game::get_game()->get_obj_manager();
 
@@ -181,7 +195,7 @@ bool SaveGame::load_original()
         return false;
        }
 
-     if(obj_manager->load_super_chunk((NuvieIO *)objblk_file,0,i) == false)
+     if(obj_manager->load_super_chunk(objblk_file,0,i) == false)
        {
         delete objblk_file;
         return false;
@@ -199,7 +213,7 @@ bool SaveGame::load_original()
    config_get_path(config, objblk_filename, path);
    objblk_file->open(path);
 
-   if(obj_manager->load_super_chunk((NuvieIO *)objblk_file, i, 0) == false)
+   if(obj_manager->load_super_chunk(objblk_file, i, 0) == false)
      {
       delete objblk_file;
       return false;
@@ -215,10 +229,7 @@ bool SaveGame::load_original()
  if(objlist_file.open(objlist_filename)==false)
    return false;
 
- data = objlist_file.readAll();
-
- objlist.open(data, objlist_file.get_size(), NUVIE_BUF_COPY);
- free(data);
+ objlist.open(objlist_file.get_raw_data(), objlist_file.get_size(), NUVIE_BUF_COPY);
 
  load_objlist();
 
@@ -291,7 +302,7 @@ bool SaveGame::load_objlist()
  return true;
 }
 
-SaveHeader *SaveGame::load_info(NuvieIOFileRead *loadfile)
+SaveHeader *SaveGame::load_info(NuvieIO *loadfile)
 {
  uint32 rmask, gmask, bmask;
  unsigned char save_desc[MAX_SAVE_DESC_LENGTH+1];
@@ -339,14 +350,14 @@ SaveHeader *SaveGame::load_info(NuvieIOFileRead *loadfile)
  return &header;
 }
 
-bool SaveGame::check_version(NuvieIOFileRead *loadfile)
+bool SaveGame::check_version(NuvieIO *loadfile)
 {
  uint16 version;
  
  loadfile->seekStart();
  
  version = loadfile->read2();
- if(version != NUVIE_SAVE_VERSION)
+ if(version != NUVIE_SAVE_VERSION && version != NUVIE_SAVE_VERSION_UNCOMPRESSED)
   {
    DEBUG(0,LEVEL_ERROR,"Incompatible savegame version. Savegame version '%d', current system version '%d'\n", version, NUVIE_SAVE_VERSION);
    return false;
@@ -355,20 +366,28 @@ bool SaveGame::check_version(NuvieIOFileRead *loadfile)
  return true;
 }
 
+/* Size of everything up to and including the thumbnail, which is all that
+ * check_version() and load_info() read.
+ */
+uint32 SaveGame::get_header_size()
+{
+ return(15 + 2 + MAX_SAVE_DESC_LENGTH + 14 + 5 + 2 + MAPWINDOW_THUMBNAIL_SIZE * MAPWINDOW_THUMBNAIL_SIZE * 3);
+}
+
 bool SaveGame::load(const char *filename)
 {
  uint8 i;
+ uint16 version;
+ uint32 objlist_offset;
  uint32 objlist_size;
- uint32 bytes_read;
- NuvieIOFileRead *loadfile;
- unsigned char *data;
+ NuvieIOMapped *loadfile;
  int game_type;
  //char game_tag[3];
  ObjManager *obj_manager = Game::get_game()->get_obj_manager();
 
  config->value("config/GameType",game_type);
 
- loadfile = new NuvieIOFileRead();
+ loadfile = new NuvieIOMapped();
 
  if(loadfile->open(filename) == false)
   {
@@ -388,34 +407,80 @@ bool SaveGame::load(const char *filename)
 
  init(obj_manager); // needs to come after checking for failure
 
+ loadfile->seekStart();
+ version = loadfile->read2();
+
  load_info(loadfile); //load header info
 
  // load actor inventories
- obj_manager->load_super_chunk((NuvieIO *)loadfile, 0, 0);
+ obj_manager->load_super_chunk(loadfile, 0, 0);
 
  // load eggs
- obj_manager->load_super_chunk((NuvieIO *)loadfile, 0, 0);
+ obj_manager->load_super_chunk(loadfile, 0, 0);
 
- // load surface objects
- for(i=0;i<64;i++)
+ if(version == NUVIE_SAVE_VERSION_UNCOMPRESSED)
    {
-    ConsoleAddInfo("Loading super chunk %d of 64", i+1);
-    obj_manager->load_super_chunk((NuvieIO *)loadfile, 0, i);
+    // load surface objects
+    for(i=0;i<64;i++)
+      {
+       ConsoleAddInfo("Loading super chunk %d of 64", i+1);
+       obj_manager->load_super_chunk(loadfile, 0, i);
+      }
+
+    // load dungeon objects
+    for(i=0;i<5;i++)
+      {
+       obj_manager->load_super_chunk(loadfile, i+1, 0);
+      }
+
+    objlist_offset = loadfile->position();
    }
-
- // load dungeon objects
- for(i=0;i<5;i++)
+ else
    {
-    obj_manager->load_super_chunk((NuvieIO *)loadfile, i+1, 0);
+    // the surface and dungeon super-chunks are only decompressed when their objects are needed
+    uint32 chunk_offset[OBJ_SUPER_CHUNK_COUNT];
+
+    for(i=0;i<OBJ_SUPER_CHUNK_COUNT;i++)
+      chunk_offset[i] = loadfile->read4();
+    objlist_offset = loadfile->read4();
+
+    for(i=0;i<OBJ_SUPER_CHUNK_COUNT;i++)
+      {
+       bool chunk_ok = false;
+       if(loadfile->get_size() >= 4 && chunk_offset[i] <= loadfile->get_size() - 4)
+         {
+          loadfile->seek(chunk_offset[i]);
+          uint32 chunk_size = loadfile->read4();
+          if(i < 64)
+            chunk_ok = obj_manager->add_compressed_super_chunk(loadfile, chunk_size, 0, i);
+          else
+            chunk_ok = obj_manager->add_compressed_super_chunk(loadfile, chunk_size, i - 63, 0);
+         }
+       if(chunk_ok == false)
+         {
+          // carrying on would lose the super-chunk's objects for good on the next save
+          DEBUG(0,LEVEL_ERROR,"Loading super-chunk %d from %s\n", i, filename);
+          ConsoleAddError("Loading savegame failed, it is damaged");
+          obj_manager->clean();
+          delete loadfile;
+          return false;
+         }
+      }
+
+    if(objlist_offset > loadfile->get_size())
+      {
+       DEBUG(0,LEVEL_ERROR,"Bad objlist offset in %s\n", filename);
+       obj_manager->clean();
+       delete loadfile;
+       return false;
+      }
    }
 
- objlist_size = loadfile->get_size() - loadfile->position();
+ objlist_size = loadfile->get_size() - objlist_offset;
 
- data = loadfile->readBuf(objlist_size, &bytes_read);
+ // objlist is written back to on save so it needs its own copy.
+ objlist.open(loadfile->get_raw_data() + objlist_offset, objlist_size, NUVIE_BUF_COPY);
 
- objlist.open(data, objlist_size, NUVIE_BUF_COPY);
-
- free(data);
  loadfile->close();
  delete loadfile;
 
@@ -427,7 +492,7 @@ bool SaveGame::load(const char *filename)
 bool SaveGame::save(const char *filename, std::string *save_description)
 {
  uint8 i;
- NuvieIOFileWrite *savefile;
+ NuvieIOBufferWrite *savefile;
  int game_type;
  char game_tag[3];
  unsigned char player_name[14];
@@ -443,10 +508,13 @@ bool SaveGame::save(const char *filename, std::string *save_description)
     config->set("config/newgame", false);
     config->write();
  }
+ bool background_save;
+ config->value("config/general/background_save", background_save, true);
 
- savefile = new NuvieIOFileWrite();
+ wait_for_save(); // only one save is written at a time
 
- savefile->open(filename);
+ // the world is serialized into memory here, only writing the file can be left to save_thread.
+ savefile = new NuvieIOBufferWrite();
 
  savefile->write2(NUVIE_SAVE_VERSION);
  savefile->writeBuf((const unsigned char *)"Nuvie Save", 11);
@@ -492,25 +560,167 @@ bool SaveGame::save(const char *filename, std::string *save_description)
 
  obj_manager->save_eggs(savefile);
 
+ // the super-chunk index is filled in once the compressed super-chunks are written.
+ uint32 index_pos = savefile->position();
+ uint32 chunk_offset[OBJ_SUPER_CHUNK_COUNT];
+ bool chunks_ok = true;
+
+ for(i=0;i<=OBJ_SUPER_CHUNK_COUNT;i++)
+   savefile->write4(0);
+
  // save surface objects
  for(i=0;i<64;i++)
-   obj_manager->save_super_chunk(savefile, 0, i);
+   {
+    chunk_offset[i] = savefile->position();
+    if(obj_manager->save_compressed_super_chunk(savefile, 0, i) == false)
+      chunks_ok = false;
+   }
 
  // save dungeon objects
  for(i=0;i<5;i++)
-   obj_manager->save_super_chunk(savefile, i+1, 0);
+   {
+    chunk_offset[64+i] = savefile->position();
+    if(obj_manager->save_compressed_super_chunk(savefile, i+1, 0) == false)
+      chunks_ok = false;
+   }
+
+ if(chunks_ok == false)
+   {
+    header.num_saves--; // nothing was saved
+    delete savefile;
+    MsgScroll *scroll = Game::get_game()->get_scroll();
+    scroll->display_string("\nSave failed!\n\n");
+    scroll->display_prompt();
+    return false;
+   }
+
+ uint32 objlist_offset = savefile->position();
+ savefile->seek(index_pos);
+ for(i=0;i<OBJ_SUPER_CHUNK_COUNT;i++)
+   savefile->write4(chunk_offset[i]);
+ savefile->write4(objlist_offset);
+ savefile->seek(objlist_offset);
 
  save_objlist();
 
  savefile->writeBuf(objlist.get_raw_data(), objlist.get_size());
 
- savefile->close();
+ save_data = savefile;
+ save_filename.assign(filename);
+
+ if(background_save)
+   {
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+    save_thread = SDL_CreateThread(save_thread_func, "Save Thread", this);
+#else
+    save_thread = SDL_CreateThread(save_thread_func, this);
+#endif
+   }
 
- delete savefile;
+ if(save_thread == NULL)
+   {
+    save_ok = write_save_file(save_filename.c_str(), save_data);
+    finish_save();
+   }
+ else
+   {
+    MsgScroll *scroll = Game::get_game()->get_scroll();
+    scroll->display_string("\nSaving...\n");
+   }
 
  return true;
 }
 
+int SaveGame::save_thread_func(void *data)
+{
+ SaveGame *savegame = (SaveGame *)data;
+
+ savegame->save_ok = write_save_file(savegame->save_filename.c_str(), savegame->save_data);
+ SDL_SemPost(savegame->save_done);
+
+ return 0;
+}
+
+/* Write `buf' to a temporary file next to `filename' and then rename it over
+ * `filename', so a failed or interrupted write leaves the old save intact.
+ */
+bool SaveGame::write_save_file(const char *filename, NuvieIOBuffer *buf)
+{
+ std::string tmp_filename(filename);
+ FILE *fp;
+ bool ok;
+
+ tmp_filename.append(".tmp");
+
+ fp = fopen(tmp_filename.c_str(), "wb");
+ if(fp == NULL)
+   {
+    DEBUG(0,LEVEL_ERROR,"Failed opening '%s'\n",tmp_filename.c_str());
+    return false;
+   }
+
+ ok = (fwrite(buf->get_raw_data(), 1, buf->get_size(), fp) == buf->get_size());
+ ok = (fflush(fp) == 0) && ok;
+#ifdef WIN32
+ ok = (_commit(_fileno(fp)) == 0) && ok;
+#else
+ ok = (fsync(fileno(fp)) == 0) && ok;
+#endif
+ ok = (fclose(fp) == 0) && ok;
+
+ if(ok)
+   {
+#ifdef WIN32
+    remove(filename); // rename() won't replace an existing file here
+#endif
+    ok = (rename(tmp_filename.c_str(), filename) == 0);
+   }
+
+ if(!ok)
+   {
+    DEBUG(0,LEVEL_ERROR,"Writing savegame '%s' failed\n",filename);
+    remove(tmp_filename.c_str());
+   }
+
+ return ok;
+}
+
+// drop the finished save's data and optionally report it. Called on the main thread.
+void SaveGame::finish_save(bool report)
+{
+ if(save_thread)
+   {
+    SDL_WaitThread(save_thread, NULL);
+    save_thread = NULL;
+   }
+
+ delete save_data;
+ save_data = NULL;
+
+ if(report)
+   {
+    MsgScroll *scroll = Game::get_game()->get_scroll();
+    scroll->display_string(save_ok ? "\nGame Saved\n\n" : "\nSave failed!\n\n");
+    scroll->display_prompt();
+   }
+}
+
+// check on the background save, once per frame.
+void SaveGame::update()
+{
+ if(save_thread && SDL_SemTryWait(save_done) == 0)
+   finish_save();
+}
+
+void SaveGame::wait_for_save(bool report)
+{
+ if(save_thread == NULL)
+   return;
+
+ SDL_SemWait(save_done);
+ finish_save(report);
+}
+
 bool SaveGame::save_objlist()
 {
  Game *game;
@@ -518,7 +728,6 @@ bool SaveGame::save_objlist()
  ActorManager *actor_manager;
  Player *player;
  Party *party;
- MsgScroll *scroll;
  Weather *weather;
  
  game = Game::get_game();
@@ -528,7 +737,6 @@ bool SaveGame::save_objlist()
 
  player = game->get_player();
  party = game->get_party();
- scroll = game->get_scroll();
  weather = game->get_weather();
 
  clock->save(&objlist);
@@ -542,13 +750,10 @@ bool SaveGame::save_objlist()
  
  game->get_script()->call_save_game(&objlist);
 
- scroll->display_string("\nGame Saved\n\n");
- scroll->display_prompt();
-
  return true;
 }
 
-bool SaveGame::save_thumbnail(NuvieIOFileWrite *savefile)
+bool SaveGame::save_thumbnail(NuvieIO *savefile)
 {
  unsigned char *thumbnail;
 
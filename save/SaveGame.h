@@ -25,10 +25,12 @@
  */
 
 #define NUVIE_SAVE_VERSION_MAJOR 0
-#define NUVIE_SAVE_VERSION_MINOR 3
+#define NUVIE_SAVE_VERSION_MINOR 4
 
 #define NUVIE_SAVE_VERSION       NUVIE_SAVE_VERSION_MAJOR * 256 + NUVIE_SAVE_VERSION_MINOR
 
+#define NUVIE_SAVE_VERSION_UNCOMPRESSED 3 // 0.3, super-chunks stored one after another without an index
+
 #define MAX_SAVE_DESC_LENGTH    52
 
 #include <string>
@@ -40,7 +42,8 @@ class ObjManager;
 class Actor;
 class Map;
 class NuvieIO;
-class NuvieIOFileWrite;
+class NuvieIOBuffer;
+class NuvieIOBufferWrite;
 
 struct SaveHeader
 {
@@ -68,6 +71,12 @@ class SaveGame
 
  NuvieIOBuffer objlist;
 
+ SDL_Thread *save_thread; // writes the pending save in the background
+ SDL_sem *save_done; // posted by save_thread once the file is written
+ NuvieIOBufferWrite *save_data; // the pending save
+ std::string save_filename;
+ bool save_ok; // set by save_thread
+
  public:
 
  SaveGame(Configuration *cfg);
@@ -77,12 +86,15 @@ class SaveGame
 
  bool load_new();
  bool load_original();
- SaveHeader *load_info(NuvieIOFileRead *loadfile);
+ SaveHeader *load_info(NuvieIO *loadfile);
  bool load(const char *filename);
 
- bool check_version(NuvieIOFileRead *loadfile);
+ bool check_version(NuvieIO *loadfile);
+ static uint32 get_header_size();
 
  bool save(const char *filename, std::string *save_description);
+ void update();
+ void wait_for_save(bool report=true);
 
 
  uint16 get_num_saves() { return header.num_saves; };
@@ -91,7 +103,11 @@ class SaveGame
 
  bool load_objlist();
  bool save_objlist();
- bool save_thumbnail(NuvieIOFileWrite *savefile);
+ bool save_thumbnail(NuvieIO *savefile);
+ void finish_save(bool report=true);
+
+ static int save_thread_func(void *data);
+ static bool write_save_file(const char *filename, NuvieIOBuffer *buf);
 
  void clean_up();
 
@@ -233,7 +233,12 @@ bool SaveManager::quick_save(int save_num, bool load)
 		}
 	}
 
-	return savegame->save(fullpath_char, &save_name); // always true
+	return savegame->save(fullpath_char, &save_name);
+}
+
+void SaveManager::update()
+{
+ savegame->update();
 }
 
 void SaveManager::create_dialog()
@@ -275,7 +280,7 @@ bool SaveManager::save(SaveSlot *save_slot)
  std::string save_fullpath;
  std::string save_desc;
 
-
+ savegame->wait_for_save(); // a pending new save must be on disk before picking a new filename
 
  save_filename.assign(save_slot->get_filename()->c_str());
 
@@ -71,6 +71,7 @@ class SaveManager : public GUI_CallBack
  bool load(SaveSlot *save_slot);
  bool save(SaveSlot *save_slot);
  bool quick_save(int save_num, bool load);
+ void update();
 
  std::string get_new_savefilename();
  std::string get_savegame_directory() { return savedir; }
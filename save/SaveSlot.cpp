@@ -92,7 +92,10 @@ bool SaveSlot::init(const char *directory, std::string *file)
 
 bool SaveSlot::load_info(const char *directory)
 {
- NuvieIOFileRead loadfile;
+ NuvieIOFileRead file;
+ NuvieIOBuffer loadfile;
+ unsigned char *header_data = NULL;
+ uint32 header_size;
  SaveGame *savegame;
  SaveHeader *header;
  GUI_Widget *widget;
@@ -106,14 +109,22 @@ bool SaveSlot::load_info(const char *directory)
 
  build_path(directory, filename.c_str(), full_path);
 
- if(loadfile.open(full_path.c_str()) == false || savegame->check_version(&loadfile) == false)
+ // only the header is needed here, so don't read the rest of the file
+ if(file.open(full_path.c_str()))
+   header_data = file.readBuf(SaveGame::get_header_size(), &header_size);
+
+ if(header_data == NULL || loadfile.open(header_data, header_size, NUVIE_BUF_NOCOPY) == false
+    || savegame->check_version(&loadfile) == false)
    {
     DEBUG(0,LEVEL_ERROR,"Reading header from %s\n", filename.c_str());
+    free(header_data);
     delete savegame;
     return false;
    }
 
  header = savegame->load_info(&loadfile);
+ loadfile.close();
+ free(header_data);
 
  save_description = header->save_description;
 
@@ -236,6 +236,184 @@ const ScalerStruct *ScalerRegistry::GetPointScaler()
 	return scaler_array;
 }
 
+//
+// Constructor
+//
+ScalerThreadPool::ScalerThreadPool() : mutex(0), job_cond(0), done_cond(0),
+	num_bands(0), next_band(0), bands_done(0), quit(false)
+{
+	memset(&job, 0, sizeof(job));
+}
+
+//
+// Destructor
+//
+ScalerThreadPool::~ScalerThreadPool()
+{
+	Stop();
+}
+
+//
+// Start the worker threads
+//
+bool ScalerThreadPool::Init(int num_threads)
+{
+	Stop();
+
+	if (num_threads <= 0) {
+		num_threads = SDL_GetCPUCount();
+		if (num_threads > 4)	// Leave some cores for the rest of the game
+			num_threads = 4;
+	}
+	if (num_threads > SCALER_THREADS_MAX)
+		num_threads = SCALER_THREADS_MAX;
+	if (num_threads <= 1)
+		return true;
+
+	mutex = SDL_CreateMutex();
+	job_cond = SDL_CreateCond();
+	done_cond = SDL_CreateCond();
+	if (!mutex || !job_cond || !done_cond) {
+		DEBUG(0,LEVEL_ERROR,"Couldn't create scaler thread locks: %s\n", SDL_GetError());
+		Stop();
+		return false;
+	}
+
+	quit = false;
+	for (int i = 1; i < num_threads; i++) {
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+		SDL_Thread *thread = SDL_CreateThread(ThreadEntry, "Scaler Thread", this);
+#else
+		SDL_Thread *thread = SDL_CreateThread(ThreadEntry, this);
+#endif
+		if (!thread) {
+			DEBUG(0,LEVEL_ERROR,"Couldn't create scaler thread: %s\n", SDL_GetError());
+			break;
+		}
+		threads.push_back(thread);
+	}
+
+	DEBUG(0,LEVEL_NOTIFICATION,"Scaling with %d threads\n", GetNumThreads());
+	return true;
+}
+
+//
+// Stop and join the worker threads
+//
+void ScalerThreadPool::Stop()
+{
+	if (!threads.empty()) {
+		SDL_LockMutex(mutex);
+		quit = true;
+		SDL_CondBroadcast(job_cond);
+		SDL_UnlockMutex(mutex);
+
+		for (size_t i = 0; i < threads.size(); i++)
+			SDL_WaitThread(threads[i], NULL);
+		threads.clear();
+	}
+
+	if (done_cond) SDL_DestroyCond(done_cond);
+	if (job_cond) SDL_DestroyCond(job_cond);
+	if (mutex) SDL_DestroyMutex(mutex);
+	done_cond = job_cond = 0;
+	mutex = 0;
+}
+
+int ScalerThreadPool::ThreadEntry(void *data)
+{
+	((ScalerThreadPool *)data)->ThreadLoop();
+	return 0;
+}
+
+//
+// Take bands of the current job until told to quit
+//
+void ScalerThreadPool::ThreadLoop()
+{
+	SDL_LockMutex(mutex);
+	while (true) {
+		while (!quit && next_band >= num_bands)
+			SDL_CondWait(job_cond, mutex);
+		if (quit)
+			break;
+
+		int band = next_band++;
+		SDL_UnlockMutex(mutex);
+		ScaleBand(band);
+		SDL_LockMutex(mutex);
+
+		if (++bands_done == num_bands)
+			SDL_CondSignal(done_cond);
+	}
+	SDL_UnlockMutex(mutex);
+}
+
+//
+// Scale the source rows of one band of the current job
+//
+void ScalerThreadPool::ScaleBand(int band)
+{
+	int y = job.srcy + job.srch*band/num_bands;
+	int h = job.srcy + job.srch*(band+1)/num_bands - y;
+
+	job.scaler->Scale(job.type, job.source, job.srcx, y, job.srcw, h,
+					job.sline_pixels, job.sheight, job.dest, job.dline_pixels,
+					job.scale_factor);
+}
+
+//
+// Scale a section of the screen, split into bands
+//
+void ScalerThreadPool::Scale(const ScalerStruct *scaler, int type, void *source,
+	int srcx, int srcy, int srcw, int srch, const int sline_pixels,
+	const int sheight, void *dest, const int dline_pixels, int scale_factor)
+{
+	int bands = srch / SCALER_THREADS_MIN_BAND_ROWS;
+	if (bands > GetNumThreads())
+		bands = GetNumThreads();
+
+	if (bands <= 1) {
+		scaler->Scale(type, source, srcx, srcy, srcw, srch, sline_pixels,
+					sheight, dest, dline_pixels, scale_factor);
+		return;
+	}
+
+	SDL_LockMutex(mutex);
+	job.scaler = scaler;
+	job.type = type;
+	job.source = source;
+	job.srcx = srcx;
+	job.srcy = srcy;
+	job.srcw = srcw;
+	job.srch = srch;
+	job.sline_pixels = sline_pixels;
+	job.sheight = sheight;
+	job.dest = dest;
+	job.dline_pixels = dline_pixels;
+	job.scale_factor = scale_factor;
+	num_bands = bands;
+	next_band = 0;
+	bands_done = 0;
+	SDL_CondBroadcast(job_cond);
+
+	// Help out instead of sitting idle
+	while (next_band < num_bands) {
+		int band = next_band++;
+		SDL_UnlockMutex(mutex);
+		ScaleBand(band);
+		SDL_LockMutex(mutex);
+		bands_done++;
+	}
+
+	while (bands_done < num_bands)
+		SDL_CondWait(done_cond, mutex);
+
+	num_bands = 0;
+	next_band = 0;
+	SDL_UnlockMutex(mutex);
+}
+
 
 #if 0
 
@@ -20,6 +20,7 @@
 #define SCALE_H_INCLUDED
 
 #include <string>
+#include <vector>
 
 #define SCALER_FLAG_2X_ONLY			1
 #define SCALER_FLAG_16BIT_ONLY		2
@@ -103,4 +104,72 @@ public:
 };
 
 
+//
+// Runs a scaler over horizontal bands of the scaled region on a small
+// persistent pool of worker threads. The calling thread scales one band too.
+//
+#define SCALER_THREADS_MAX				8
+#define SCALER_THREADS_MIN_BAND_ROWS	16	// Don't split regions into smaller bands
+
+class ScalerThreadPool {
+	struct Job {
+		const ScalerStruct	*scaler;
+		int					type;
+		void				*source;
+		int					srcx, srcy, srcw, srch;
+		int					sline_pixels;
+		int					sheight;
+		void				*dest;
+		int					dline_pixels;
+		int					scale_factor;
+	};
+
+	std::vector<SDL_Thread *>	threads;
+	SDL_mutex				*mutex;
+	SDL_cond				*job_cond;		// Signalled when bands are queued or on quit
+	SDL_cond				*done_cond;		// Signalled when the last band is finished
+	Job						job;
+	int						num_bands;
+	int						next_band;		// Next band to be taken by a thread
+	int						bands_done;
+	bool					quit;
+
+	static int				ThreadEntry(void *data);
+	void					ThreadLoop();
+	void					ScaleBand(int band);
+
+public:
+
+	// Constructor
+	ScalerThreadPool();
+
+	// Destructor
+	~ScalerThreadPool();
+
+	// Start the worker threads. 0 picks a count from the number of CPUs,
+	// 1 scales on the calling thread only.
+	bool			Init(int num_threads);
+
+	// Stop and join the worker threads
+	void			Stop();
+
+	// Get the number of threads scaling, including the calling thread
+	int				GetNumThreads() { return (int)threads.size() + 1; }
+
+	// Scale a section of the screen, split into bands. Same arguments as
+	// ScalerStruct::Scale(). Returns when every band is done.
+	void			Scale(
+			const ScalerStruct *scaler,
+			int type,
+			void *source,
+			int srcx, int srcy,
+			int srcw, int srch,
+			const int sline_pixels,
+			const int sheight,
+			void *dest,
+			const int dline_pixels,
+			int scale_factor
+		);
+};
+
 #endif // SCALE_H_INCLUDED
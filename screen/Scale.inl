@@ -97,6 +97,166 @@ public:
 	}
 };
 
+/*
+ *	SSE2 kernels used by Scale_point, Scale_Scale2x and Scale_Bilinear.
+ *	They give the same output as the plain C loops, which are still used
+ *	for row ends and when the CPU lacks SSE2. Build with SCALE_NO_SIMD to
+ *	leave them out.
+ */
+#if !defined(SCALE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SCALE_USE_SSE2
+#include <emmintrin.h>
+#include <type_traits>
+
+class ScaleSSE2
+{
+	// Pick a where mask is set, b elsewhere
+	inline static __m128i select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+public:
+	inline static bool available()
+	{
+		static const bool has_sse2 = SDL_HasSSE2() ? true : false;
+		return has_sse2;
+	}
+
+	// Double w pixels from src into dst0 and dst1. Returns the number of
+	// pixels done, which is w rounded down to a whole number of registers.
+	inline static int point2x_row(const uint16 *src, uint16 *dst0, uint16 *dst1, int w)
+	{
+		int x = 0;
+		for (; x + 8 <= w; x += 8)
+		{
+			__m128i p = _mm_loadu_si128((const __m128i *)(src + x));
+			__m128i lo = _mm_unpacklo_epi16(p, p);
+			__m128i hi = _mm_unpackhi_epi16(p, p);
+			_mm_storeu_si128((__m128i *)(dst0 + 2*x), lo);
+			_mm_storeu_si128((__m128i *)(dst0 + 2*x + 8), hi);
+			_mm_storeu_si128((__m128i *)(dst1 + 2*x), lo);
+			_mm_storeu_si128((__m128i *)(dst1 + 2*x + 8), hi);
+		}
+		return x;
+	}
+
+	inline static int point2x_row(const uint32 *src, uint32 *dst0, uint32 *dst1, int w)
+	{
+		int x = 0;
+		for (; x + 4 <= w; x += 4)
+		{
+			__m128i p = _mm_loadu_si128((const __m128i *)(src + x));
+			__m128i lo = _mm_unpacklo_epi32(p, p);
+			__m128i hi = _mm_unpackhi_epi32(p, p);
+			_mm_storeu_si128((__m128i *)(dst0 + 2*x), lo);
+			_mm_storeu_si128((__m128i *)(dst0 + 2*x + 4), hi);
+			_mm_storeu_si128((__m128i *)(dst1 + 2*x), lo);
+			_mm_storeu_si128((__m128i *)(dst1 + 2*x + 4), hi);
+		}
+		return x;
+	}
+
+	// Scale2x the middle pixels of a row. src1[-1] and src1[w] must be
+	// readable. Returns the number of pixels done.
+	inline static int scale2x_row(const uint16 *src0, const uint16 *src1, const uint16 *src2,
+	                              uint16 *dest0, uint16 *dest1, int w)
+	{
+		int x = 0;
+		for (; x + 8 <= w; x += 8)
+		{
+			__m128i B = _mm_loadu_si128((const __m128i *)(src0 + x));
+			__m128i D = _mm_loadu_si128((const __m128i *)(src1 + x - 1));
+			__m128i E = _mm_loadu_si128((const __m128i *)(src1 + x));
+			__m128i F = _mm_loadu_si128((const __m128i *)(src1 + x + 1));
+			__m128i H = _mm_loadu_si128((const __m128i *)(src2 + x));
+
+			__m128i BH = _mm_cmpeq_epi16(B, H);
+			__m128i DB = _mm_cmpeq_epi16(D, B), FB = _mm_cmpeq_epi16(F, B);
+			__m128i DH = _mm_cmpeq_epi16(D, H), FH = _mm_cmpeq_epi16(F, H);
+
+			__m128i e0 = select(_mm_andnot_si128(_mm_or_si128(BH, FB), DB), B, E);
+			__m128i e1 = select(_mm_andnot_si128(_mm_or_si128(BH, DB), FB), B, E);
+			__m128i e2 = select(_mm_andnot_si128(_mm_or_si128(BH, FH), DH), H, E);
+			__m128i e3 = select(_mm_andnot_si128(_mm_or_si128(BH, DH), FH), H, E);
+
+			_mm_storeu_si128((__m128i *)(dest0 + 2*x), _mm_unpacklo_epi16(e0, e1));
+			_mm_storeu_si128((__m128i *)(dest0 + 2*x + 8), _mm_unpackhi_epi16(e0, e1));
+			_mm_storeu_si128((__m128i *)(dest1 + 2*x), _mm_unpacklo_epi16(e2, e3));
+			_mm_storeu_si128((__m128i *)(dest1 + 2*x + 8), _mm_unpackhi_epi16(e2, e3));
+		}
+		return x;
+	}
+
+	inline static int scale2x_row(const uint32 *src0, const uint32 *src1, const uint32 *src2,
+	                              uint32 *dest0, uint32 *dest1, int w)
+	{
+		int x = 0;
+		for (; x + 4 <= w; x += 4)
+		{
+			__m128i B = _mm_loadu_si128((const __m128i *)(src0 + x));
+			__m128i D = _mm_loadu_si128((const __m128i *)(src1 + x - 1));
+			__m128i E = _mm_loadu_si128((const __m128i *)(src1 + x));
+			__m128i F = _mm_loadu_si128((const __m128i *)(src1 + x + 1));
+			__m128i H = _mm_loadu_si128((const __m128i *)(src2 + x));
+
+			__m128i BH = _mm_cmpeq_epi32(B, H);
+			__m128i DB = _mm_cmpeq_epi32(D, B), FB = _mm_cmpeq_epi32(F, B);
+			__m128i DH = _mm_cmpeq_epi32(D, H), FH = _mm_cmpeq_epi32(F, H);
+
+			__m128i e0 = select(_mm_andnot_si128(_mm_or_si128(BH, FB), DB), B, E);
+			__m128i e1 = select(_mm_andnot_si128(_mm_or_si128(BH, DB), FB), B, E);
+			__m128i e2 = select(_mm_andnot_si128(_mm_or_si128(BH, FH), DH), H, E);
+			__m128i e3 = select(_mm_andnot_si128(_mm_or_si128(BH, DH), FH), H, E);
+
+			_mm_storeu_si128((__m128i *)(dest0 + 2*x), _mm_unpacklo_epi32(e0, e1));
+			_mm_storeu_si128((__m128i *)(dest0 + 2*x + 4), _mm_unpackhi_epi32(e0, e1));
+			_mm_storeu_si128((__m128i *)(dest1 + 2*x), _mm_unpacklo_epi32(e2, e3));
+			_mm_storeu_si128((__m128i *)(dest1 + 2*x + 4), _mm_unpackhi_epi32(e2, e3));
+		}
+		return x;
+	}
+
+	// Bilinear 2x of a 32-bit 888 row, where cur is the source row and next
+	// the one below it. cur[w] and next[w] must be readable. Returns the
+	// number of pixels done.
+	inline static int bilinear888_row(const uint32 *cur, const uint32 *next,
+	                                  uint32 *to, uint32 *to_odd, int w)
+	{
+		const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+		const __m128i zero = _mm_setzero_si128();
+		int x = 0;
+		for (; x + 4 <= w; x += 4)
+		{
+			__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(cur + x)), rgb_mask);
+			__m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(cur + x + 1)), rgb_mask);
+			__m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i *)(next + x)), rgb_mask);
+			__m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i *)(next + x + 1)), rgb_mask);
+
+			// Widen the components to 16 bits so the sums can't overflow
+			__m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+			__m128i b_lo = _mm_unpacklo_epi8(b, zero), b_hi = _mm_unpackhi_epi8(b, zero);
+			__m128i c_lo = _mm_unpacklo_epi8(c, zero), c_hi = _mm_unpackhi_epi8(c, zero);
+			__m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+
+			__m128i ab_lo = _mm_add_epi16(a_lo, b_lo), ab_hi = _mm_add_epi16(a_hi, b_hi);
+			__m128i upper_right = _mm_packus_epi16(_mm_srli_epi16(ab_lo, 1), _mm_srli_epi16(ab_hi, 1));
+			__m128i lower_left = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(a_lo, c_lo), 1),
+			                                      _mm_srli_epi16(_mm_add_epi16(a_hi, c_hi), 1));
+			__m128i lower_right = _mm_packus_epi16(
+			        _mm_srli_epi16(_mm_add_epi16(ab_lo, _mm_add_epi16(c_lo, d_lo)), 2),
+			        _mm_srli_epi16(_mm_add_epi16(ab_hi, _mm_add_epi16(c_hi, d_hi)), 2));
+
+			_mm_storeu_si128((__m128i *)(to + 2*x), _mm_unpacklo_epi32(a, upper_right));
+			_mm_storeu_si128((__m128i *)(to + 2*x + 4), _mm_unpackhi_epi32(a, upper_right));
+			_mm_storeu_si128((__m128i *)(to_odd + 2*x), _mm_unpacklo_epi32(lower_left, lower_right));
+			_mm_storeu_si128((__m128i *)(to_odd + 2*x + 4), _mm_unpackhi_epi32(lower_left, lower_right));
+		}
+		return x;
+	}
+};
+#endif
+
 
 template <class Pixel_type, class Manip_pixels> class Scalers {
 public:
@@ -907,7 +1067,7 @@ static void Scale_Scale2x
 		limit_x--;		// Stop 1 pixel before it.
 	while (src1 < limit_y)
 		{
-		if (src2 > end_src)
+		if (src2 >= end_src)
 			src2 = src1;	// On last row.
 		if (srcx == 0)		// First pixel.
 			{
@@ -924,6 +1084,14 @@ static void Scale_Scale2x
 			dest0 += 2; dest1 += 2;
 			}
 					// Middle pixels.
+#ifdef SCALE_USE_SSE2
+		if (ScaleSSE2::available())
+			{
+			int done = ScaleSSE2::scale2x_row(src0, src1, src2, dest0, dest1, limit_x - src1);
+			src0 += done; src1 += done; src2 += done;
+			dest0 += 2*done; dest1 += 2*done;
+			}
+#endif
 		while (src1 < limit_x)
 			{
 			if (src1[-1] == src0[0] && src2[0] != src0[0] &&
@@ -1033,12 +1201,55 @@ static void Scale_Bilinear
 	Pixel_type *to = dest + 2*srcy*dline_pixels + 2*srcx;
 	Pixel_type *to_odd = to + dline_pixels;
 
+#ifdef SCALE_USE_SSE2
+	if (std::is_same<Manip_pixels, ManipRGB888>::value && ScaleSSE2::available())
+		{
+		int from_width = sline_pixels - srcx;
+		if (srcw+1 < from_width)
+			from_width = srcw+1;
+		int simd_width = srcw < from_width-1 ? srcw : from_width-1;
+
+		for (int y=0; y < srch; y++)
+			{
+			Pixel_type *next = (srcy+y+1 < sheight) ? from+sline_pixels : from;
+			int x = ScaleSSE2::bilinear888_row((const uint32 *)from, (const uint32 *)next,
+			                                   (uint32 *)to, (uint32 *)to_odd, simd_width);
+
+			// the rest of the row, repeating the last source pixel like
+			// fill_rgb_row() does
+			for (; x < srcw; x++)
+				{
+				int ax = x < from_width ? x : from_width-1;
+				int bx = x+1 < from_width ? x+1 : from_width-1;
+				COMPONENT ar, ag, ab, br, bg, bb, cr, cg, cb, dr, dg, db;
+				Manip_pixels::split_col(from[ax], ar, ag, ab);
+				Manip_pixels::split_col(from[bx], br, bg, bb);
+				Manip_pixels::split_col(next[ax], cr, cg, cb);
+				Manip_pixels::split_col(next[bx], dr, dg, db);
+
+				to[2*x] = Manip_pixels::rgb(ar, ag, ab);
+				to[2*x+1] = Manip_pixels::rgb((ar+br)>>1, (ag+bg)>>1, (ab+bb)>>1);
+				to_odd[2*x] = Manip_pixels::rgb((ar+cr)>>1, (ag+cg)>>1, (ab+cb)>>1);
+				to_odd[2*x+1] = Manip_pixels::rgb((ar+br+cr+dr)>>2,
+				                                  (ag+bg+cg+dg)>>2,
+				                                  (ab+bb+cb+db)>>2);
+				}
+
+			from += sline_pixels;
+			to += 2*dline_pixels;
+			to_odd = to + dline_pixels;
+			}
+		return;
+		}
+#endif
+
 	// the following are static because we don't want to be freeing and
 	// reallocating space on each call, as malloc()s are usually very
-	// expensive; we do allow it to grow though
-	static int buff_size = 0;
-	static COMPONENT *rgb_row_cur  = 0;
-	static COMPONENT *rgb_row_next = 0;
+	// expensive; we do allow it to grow though. They are per thread as
+	// ScalerThreadPool can run a scaler on several bands at once
+	thread_local int buff_size = 0;
+	thread_local COMPONENT *rgb_row_cur  = 0;
+	thread_local COMPONENT *rgb_row_next = 0;
 	if (buff_size < sline_pixels+1) {
 		delete [] rgb_row_cur;
 		delete [] rgb_row_next;
@@ -1058,7 +1269,7 @@ static void Scale_Bilinear
 		Pixel_type *from_orig = from;
 		Pixel_type *to_orig = to;
 
-		if (y+1 < sheight)
+		if (srcy+y+1 < sheight)
 			fill_rgb_row(from+sline_pixels, from_width, rgb_row_next,
 						 srcw+1);
 		else
@@ -1144,8 +1355,8 @@ static void Scale_BilinearInterlaced
 	// the following are static because we don't want to be freeing and
 	// reallocating space on each call, as malloc()s are usually very
 	// expensive; we do allow it to grow though
-	static int buff_size = 0;
-	static COMPONENT *rgb_row_cur  = 0;
+	thread_local int buff_size = 0;
+	thread_local COMPONENT *rgb_row_cur  = 0;
 	if (buff_size < sline_pixels+1) {
 		delete [] rgb_row_cur;
 		buff_size = sline_pixels+1;
@@ -1218,9 +1429,9 @@ static void Scale_BilinearHalfInterlaced
 	// the following are static because we don't want to be freeing and
 	// reallocating space on each call, as malloc()s are usually very
 	// expensive; we do allow it to grow though
-	static int buff_size = 0;
-	static COMPONENT *rgb_row_cur  = 0;
-	static COMPONENT *rgb_row_next = 0;
+	thread_local int buff_size = 0;
+	thread_local COMPONENT *rgb_row_cur  = 0;
+	thread_local COMPONENT *rgb_row_next = 0;
 	if (buff_size < sline_pixels+1) {
 		delete [] rgb_row_cur;
 		delete [] rgb_row_next;
@@ -1240,7 +1451,7 @@ static void Scale_BilinearHalfInterlaced
 		Pixel_type *from_orig = from;
 		Pixel_type *to_orig = to;
 
-		if (y+1 < sheight)
+		if (srcy+y+1 < sheight)
 			fill_rgb_row(from+sline_pixels, from_width, rgb_row_next,
 						 srcw+1);
 		else
@@ -1327,9 +1538,9 @@ static void Scale_BilinearQuarterInterlaced
 	// the following are static because we don't want to be freeing and
 	// reallocating space on each call, as malloc()s are usually very
 	// expensive; we do allow it to grow though
-	static int buff_size = 0;
-	static COMPONENT *rgb_row_cur  = 0;
-	static COMPONENT *rgb_row_next = 0;
+	thread_local int buff_size = 0;
+	thread_local COMPONENT *rgb_row_cur  = 0;
+	thread_local COMPONENT *rgb_row_next = 0;
 	if (buff_size < sline_pixels+1) {
 		delete [] rgb_row_cur;
 		delete [] rgb_row_next;
@@ -1349,7 +1560,7 @@ static void Scale_BilinearQuarterInterlaced
 		Pixel_type *from_orig = from;
 		Pixel_type *to_orig = to;
 
-		if (y+1 < sheight)
+		if (srcy+y+1 < sheight)
 			fill_rgb_row(from+sline_pixels, from_width, rgb_row_next,
 						 srcw+1);
 		else
@@ -1442,9 +1653,9 @@ static void Scale_BilinearPlus
 	// the following are static because we don't want to be freeing and
 	// reallocating space on each call, as malloc()s are usually very
 	// expensive; we do allow it to grow though
-	static int buff_size = 0;
-	static COMPONENT *rgb_row_cur  = 0;
-	static COMPONENT *rgb_row_next = 0;
+	thread_local int buff_size = 0;
+	thread_local COMPONENT *rgb_row_cur  = 0;
+	thread_local COMPONENT *rgb_row_next = 0;
 	if (buff_size < sline_pixels+1) {
 		delete [] rgb_row_cur;
 		delete [] rgb_row_next;
@@ -1464,7 +1675,7 @@ static void Scale_BilinearPlus
 		Pixel_type *from_orig = from;
 		Pixel_type *to_orig = to;
 
-		if (y+1 < sheight)
+		if (srcy+y+1 < sheight)
 			fill_rgb_row(from+sline_pixels, from_width, rgb_row_next,
 						 srcw+1);
 		else
@@ -1555,12 +1766,12 @@ static void Scale_point
 	int factor					// Scale Factor
 )
 {
-	static Pixel_type *dest;
-	static const Pixel_type *source;
-	static const Pixel_type *limit_y;
-	static const Pixel_type *limit_x;
-	static int pitch_src;
-	static int add_dst;
+	Pixel_type *dest;
+	const Pixel_type *source;
+	const Pixel_type *limit_y;
+	const Pixel_type *limit_x;
+	int pitch_src;
+	int add_dst;
 
 	source = src + srcy*sline_pixels + srcx;
 	dest = dst + srcy*factor*dline_pixels + srcx*factor;
@@ -1573,14 +1784,23 @@ static void Scale_point
 
 	// Slightly Optimzed 16 bit 2x
 	if (factor == 2 && sizeof(Pixel_type) == 2) {
-		static Pixel_type *dest2;
+		Pixel_type *dest2;
 		uint32 data;
-		static int add_src;
+		int add_src;
 		add_src = pitch_src - srcw;
 		while (source < limit_y)
 		{
 			dest2 = dest;
 			dest += dline_pixels;
+#ifdef SCALE_USE_SSE2
+			if (ScaleSSE2::available())
+			{
+				int done = ScaleSSE2::point2x_row(source, dest2, dest, srcw);
+				source += done;
+				dest2 += done*2;
+				dest += done*2;
+			}
+#endif
 
 			while (source < limit_x)
 			{
@@ -1599,13 +1819,22 @@ static void Scale_point
 	// Slightly Optimzed 32 bit 2x
 	else if (factor == 2) {
 		Pixel_type data;
-		static Pixel_type *dest2;
-		static int add_src;
+		Pixel_type *dest2;
+		int add_src;
 		add_src = pitch_src - srcw;
 		while (source < limit_y)
 		{
 			dest2 = dest;
 			dest += dline_pixels;
+#ifdef SCALE_USE_SSE2
+			if (ScaleSSE2::available())
+			{
+				int done = ScaleSSE2::point2x_row(source, dest2, dest, srcw);
+				source += done;
+				dest2 += done*2;
+				dest += done*2;
+			}
+#endif
 
 			while (source < limit_x)
 			{
@@ -1623,11 +1852,11 @@ static void Scale_point
 	else
 	{
 		Pixel_type data;
-		static unsigned int src_sub;
-		static unsigned int scale_factor;
-		static unsigned int dline_pixels_scaled;
-		static const Pixel_type * limit_y2;
-		static const Pixel_type * limit_x2;
+		unsigned int src_sub;
+		unsigned int scale_factor;
+		unsigned int dline_pixels_scaled;
+		const Pixel_type * limit_y2;
+		const Pixel_type * limit_x2;
 
 		src_sub = srcw;
 		scale_factor = factor;
@@ -1670,12 +1899,12 @@ static void Scale_interlaced
 	int factor					// Scale Factor
 )
 {
-	static Pixel_type *dest;
-	static const Pixel_type *source;
-	static const Pixel_type *limit_y;
-	static const Pixel_type *limit_x;
-	static int pitch_src;
-	static int add_dst;
+	Pixel_type *dest;
+	const Pixel_type *source;
+	const Pixel_type *limit_y;
+	const Pixel_type *limit_x;
+	int pitch_src;
+	int add_dst;
 
 	source = src + srcy*sline_pixels + srcx;
 	dest = dst + srcy*factor*dline_pixels + srcx*factor;
@@ -1689,7 +1918,7 @@ static void Scale_interlaced
 	// Slightly Optimzed 16 bit 2x
 	if (factor == 2 && sizeof(Pixel_type) == 2) {
 		uint32 data;
-		static int add_src;
+		int add_src;
 		add_src = pitch_src - srcw;
 		add_dst += dline_pixels;
 		while (source < limit_y)
@@ -1708,7 +1937,7 @@ static void Scale_interlaced
 	// Slightly Optimzed 32 bit 2x
 	else if (factor == 2) {
 		Pixel_type data;
-		static int add_src;
+		int add_src;
 		add_src = pitch_src - srcw;
 		add_dst += dline_pixels;
 		while (source < limit_y)
@@ -1727,12 +1956,12 @@ static void Scale_interlaced
 	else
 	{
 		Pixel_type data;
-		static unsigned int src_sub;
-		static unsigned int scale_factor;
-		static unsigned int dline_pixels_scaled;
-		static unsigned int	skipped;
-		static const Pixel_type * limit_y2;
-		static const Pixel_type * limit_x2;
+		unsigned int src_sub;
+		unsigned int scale_factor;
+		unsigned int dline_pixels_scaled;
+		unsigned int	skipped;
+		const Pixel_type * limit_y2;
+		const Pixel_type * limit_x2;
 
 		src_sub = srcw;
 		scale_factor = factor;
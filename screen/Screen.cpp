@@ -43,10 +43,18 @@
 #include "Background.h"
 
 #define sqr(a) ((a)*(a))
+#define PALETTE_CYCLED_FIRST 0xe0 // GamePalette only rotates palette entries from here up
 
 //Ultima 6 light globe sizes.
 #define NUM_GLOBES 5
 #define SHADING_BORDER 2 // should be the same as MapWindow's TMP_MAP_BORDER
+#define SHADING_LIGHT_STEP 4 // smooth lighting is worked out at every 4th pixel, and globe centres are on this grid
+
+// SSE2 is always there on x86-64, so it doesn't need its own build flags
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCREEN_SHADE_SSE2
+#include <emmintrin.h>
+#endif
 static const sint32 globeradius[]   = { 36, 112, 148, 192, 448 };
 static const sint32 globeradius_2[] = { 18, 56, 74, 96, 224 };
 
@@ -59,6 +67,9 @@ Screen::Screen(Configuration *cfg)
  scaler = NULL;
  update_rects = NULL;
  shading_data = NULL;
+ shading_light = NULL;
+ shading_light_w = shading_light_h = 0;
+ shading_light_changed = false;
  scaler_index = 0;
  scale_factor = 2;
  fullscreen = false;
@@ -81,14 +92,25 @@ Screen::Screen(Configuration *cfg)
  old_lighting_style = lighting_style;
  max_update_rects = 10;
  num_update_rects = 0;
+ dirty_rect_update = false;
+ full_update_pending = true;
+ update_pixel_count = 0;
+ index_buf = NULL;
+ memset( resolved_colour32, 0, sizeof(resolved_colour32) );
+ palette_changed = false;
+ palette_revision = 0;
+ palette_set_revision = 0;
  memset( shading_globe, 0, sizeof(shading_globe) );
 }
 
 Screen::~Screen()
 {
+ scaler_threads.Stop();
  delete surface;
  if (update_rects) free(update_rects);
  if (shading_data) free(shading_data);
+ if (shading_light) free(shading_light);
+ if (index_buf) free(index_buf);
 
  for( int i = 0; i < NUM_GLOBES; i++ )
    {
@@ -139,9 +161,19 @@ config->value("config/video/scale_factor", scale_factor, 1);
 
  config->value("config/video/fullscreen", fullscreen, false);
  config->value("config/video/non_square_pixels", non_square_pixels, false);
+ config->value("config/video/dirty_rect_update", dirty_rect_update, false);
+
+ int scaler_thread_count;
+ config->value("config/video/scaler_threads", scaler_thread_count, 0);
+ scaler_threads.Init(scaler_thread_count);
 
  set_screen_mode();
 
+ bool indexed_framebuffer;
+ config->value("config/video/indexed_framebuffer", indexed_framebuffer, false);
+ if(indexed_framebuffer && surface)
+   index_buf = (uint16 *)calloc(surface->w * surface->h, sizeof(uint16));
+
 #if SDL_VERSION_ATLEAST(2, 0, 0)
     SDL_SetRenderDrawColor(sdlRenderer, 0, 0, 0, 255);
     SDL_RenderClear(sdlRenderer);
@@ -186,6 +218,9 @@ bool Screen::set_palette(uint8 *p)
 
 		surface->colour32[i] = c;
 	 }
+ palette_changed = true;
+ palette_revision++;
+ palette_set_revision++;
 
  return true;
 }
@@ -198,6 +233,9 @@ bool Screen::set_palette_entry(uint8 idx, uint8 r, uint8 g, uint8 b)
  uint32	c= ((((uint32)r)>>RenderSurface::Rloss)<<RenderSurface::Rshift) | ((((uint32)g)>>RenderSurface::Gloss)<<RenderSurface::Gshift) | ((((uint32)b)>>RenderSurface::Bloss)<<RenderSurface::Bshift);
 
  surface->colour32[idx] = c;
+ palette_changed = true;
+ palette_revision++;
+ palette_set_revision++;
 
  return true;
 }
@@ -213,6 +251,10 @@ bool Screen::rotate_palette(uint8 pos, uint8 length)
     surface->colour32[pos + i] = surface->colour32[pos + i - 1];
 
  surface->colour32[pos] = tmp_colour;
+ palette_changed = true;
+ palette_revision++;
+ if(pos < PALETTE_CYCLED_FIRST)
+   palette_set_revision++; // native tiles only reconvert cycled colours
 
  return true;
 }
@@ -302,6 +344,8 @@ bool Screen::clear(sint16 x, sint16 y, sint16 w, sint16 h,SDL_Rect *clip_rect)
      pixels += surface->pitch;
     }
 
+ index_fill(SCREEN_INDEX_NONE, x, y, w, h); // zeroed, not drawn from the palette
+
  return true;
 }
 
@@ -322,6 +366,9 @@ bool Screen::fill(uint8 colour_num, uint16 x, uint16 y, sint16 w, sint16 h)
 		w = surface->w - x;
 	}
 
+ if(w > 0 && h > 0)
+    index_fill(colour_num, x, y, w, h);
+
  if(surface->bits_per_pixel == 16)
     return fill16(colour_num, x, y, w, h);
 
@@ -370,6 +417,7 @@ bool Screen::fill32(uint8 colour_num, uint16 x, uint16 y, sint16 w, sint16 h)
 }
 void Screen::fade(uint16 dest_x, uint16 dest_y, uint16 src_w, uint16 src_h, uint8 opacity, uint8 fade_bg_color)
 {
+index_fill(SCREEN_INDEX_NONE, dest_x, dest_y, src_w, src_h); // blended colours have no index
 if(surface->bits_per_pixel == 16)
 	fade16(dest_x, dest_y, src_w, src_h, opacity, fade_bg_color);
 else
@@ -458,6 +506,8 @@ void Screen::stipple_8bit(uint8 color_num, uint16 x, uint16 y, uint16 w, uint16
 			for(j=x;j<x+w;j+=2)
 			{
 				*pixels = color;
+				if(index_buf)
+					index_buf[pixels - (uint16 *)surface->pixels] = color_num;
 				pixels += 2;
 			}
 			pixels += (surface->w - j) + x;
@@ -483,6 +533,8 @@ void Screen::stipple_8bit(uint8 color_num, uint16 x, uint16 y, uint16 w, uint16
 			for(j=x;j<x+w;j+=2)
 			{
 				*pixels = color;
+				if(index_buf)
+					index_buf[pixels - (uint32 *)surface->pixels] = color_num;
 				pixels += 2;
 			}
 			pixels += (surface->w - j) + x;
@@ -499,6 +551,9 @@ void Screen::stipple_8bit(uint8 color_num, uint16 x, uint16 y, uint16 w, uint16
 }
 void Screen::put_pixel(uint8 colour_num, uint16 x, uint16 y)
 {
+	if(index_buf)
+		index_buf[y * surface->w + x] = colour_num;
+
 	if(surface->bits_per_pixel == 16)
 	{
 		uint16 *pixel = (uint16 *)surface->pixels + y * surface->w + x;
@@ -606,6 +661,11 @@ bool Screen::blit(sint32 dest_x, sint32 dest_y, unsigned char *src_buf, uint16 s
    src_buf += src_y * src_pitch + src_x;
   }
 
+ if(opacity == 255)
+   index_blit(dest_x, dest_y, src_buf, src_w, src_h, src_pitch, trans);
+ else
+   index_fill(SCREEN_INDEX_NONE, dest_x, dest_y, src_w, src_h);
+
  if(surface->bits_per_pixel == 16)
  {
 	 if(opacity < 255)
@@ -620,6 +680,112 @@ bool Screen::blit(sint32 dest_x, sint32 dest_y, unsigned char *src_buf, uint16 s
  return blit32(dest_x, dest_y, src_buf, src_bpp, src_w, src_h, src_pitch, trans);
 }
 
+/* Copy the opaque runs of a native tile that fall inside the w,h area from
+ * src_x,src_y, to pixels.
+ */
+template<class T>
+static void blit_native_runs(T *pixels, uint16 pitch, const NativeTile *native, uint16 src_x, uint16 src_y, uint16 w, uint16 h)
+{
+ const T *src = (const T *)native->pixels + src_y * TILE_WIDTH;
+ uint16 src_x_end = src_x + w;
+
+ for(uint16 y=src_y;y<src_y+h;y++)
+   {
+    for(uint8 r=0;r<native->num_runs[y];r++)
+      {
+       uint16 start = native->run_start[y][r];
+       uint16 end = start + native->run_len[y][r];
+       if(start < src_x)
+         start = src_x;
+       if(end > src_x_end)
+         end = src_x_end;
+       if(start < end)
+         memcpy(pixels + (start - src_x), src + start, (end - start) * sizeof(T));
+      }
+    src += TILE_WIDTH;
+    pixels += pitch;
+   }
+}
+
+/* Blit a tile like blit() does, but from `native', its copy in the screen's
+ * pixel format, if it has one. The copy is converted again when the palette
+ * has changed since it was made.
+ */
+bool Screen::blit_tile(sint32 dest_x, sint32 dest_y, const Tile *tile, NativeTile *native, SDL_Rect *clip_rect)
+{
+ if(native == NULL)
+   return blit(dest_x, dest_y, (unsigned char *)tile->data, 8, TILE_WIDTH, TILE_HEIGHT, TILE_WIDTH, tile->transparent, clip_rect);
+
+ sint32 x1 = MAX(dest_x, 0), y1 = MAX(dest_y, 0);
+ sint32 x2 = MIN(dest_x + TILE_WIDTH, (sint32)width), y2 = MIN(dest_y + TILE_HEIGHT, (sint32)height);
+ if(clip_rect)
+   {
+    x1 = MAX(x1, (sint32)clip_rect->x);
+    y1 = MAX(y1, (sint32)clip_rect->y);
+    x2 = MIN(x2, (sint32)clip_rect->x + clip_rect->w);
+    y2 = MIN(y2, (sint32)clip_rect->y + clip_rect->h);
+   }
+ if(x1 >= x2 || y1 >= y2)
+   return false;
+
+ if(!native->built || native->transparent != tile->transparent
+    || native->palette_set_revision != palette_set_revision
+    || (native->cycled && native->palette_revision != palette_revision))
+   build_native_tile(tile, native);
+
+ uint16 src_x = x1 - dest_x, src_y = y1 - dest_y;
+ index_blit(x1, y1, &tile->data[src_y * TILE_WIDTH + src_x], x2 - x1, y2 - y1, TILE_WIDTH, tile->transparent);
+
+ if(surface->bits_per_pixel == 16)
+   blit_native_runs((uint16 *)surface->pixels + y1 * surface->w + x1, surface->w, native, src_x, src_y, x2 - x1, y2 - y1);
+ else
+   blit_native_runs((uint32 *)surface->pixels + y1 * surface->w + x1, surface->w, native, src_x, src_y, x2 - x1, y2 - y1);
+
+ return true;
+}
+
+/* Convert a tile to the screen's pixel format with the current palette, and
+ * find the runs of pixels that blit() would draw in each row.
+ */
+void Screen::build_native_tile(const Tile *tile, NativeTile *native)
+{
+ native->cycled = false;
+ for(uint16 i=0;i<TILE_DATA_SIZE;i++)
+   {
+    uint8 p = tile->data[i];
+    if(surface->bits_per_pixel == 16)
+      ((uint16 *)native->pixels)[i] = (uint16)surface->colour32[p];
+    else
+      native->pixels[i] = surface->colour32[p];
+    if(p >= PALETTE_CYCLED_FIRST && (p != 0xff || !tile->transparent))
+      native->cycled = true;
+   }
+
+ for(uint16 y=0;y<TILE_HEIGHT;y++)
+   {
+    const unsigned char *row = &tile->data[y * TILE_WIDTH];
+    uint8 n = 0;
+    for(uint16 x=0;x<TILE_WIDTH;)
+      {
+       if(tile->transparent && row[x] == 0xff)
+         {
+          x++;
+          continue;
+         }
+       native->run_start[y][n] = x;
+       while(x < TILE_WIDTH && !(tile->transparent && row[x] == 0xff))
+         x++;
+       native->run_len[y][n] = x - native->run_start[y][n];
+       n++;
+      }
+    native->num_runs[y] = n;
+   }
+
+ native->transparent = tile->transparent;
+ native->palette_revision = palette_revision;
+ native->palette_set_revision = palette_set_revision;
+ native->built = true;
+}
 
 inline uint16 Screen::blendpixel16(uint16 p, uint16 p1, uint8 opacity)
 {
@@ -791,6 +957,19 @@ bool Screen::blit32WithOpacity(uint16 dest_x, uint16 dest_y, unsigned char *src_
 
 void Screen::blitbitmap(uint16 dest_x, uint16 dest_y, const unsigned char *src_buf, uint16 src_w, uint16 src_h, uint8 fg_color, uint8 bg_color)
 {
+ if(index_buf)
+   {
+    uint16 *index = index_buf + dest_y * surface->w + dest_x;
+    const unsigned char *bitmap = src_buf;
+    for(uint16 i=0;i<src_h;i++)
+      {
+       for(uint16 j=0;j<src_w;j++)
+         index[j] = bitmap[j] ? fg_color : bg_color;
+       bitmap += src_w;
+       index += surface->w;
+      }
+   }
+
  if(surface->bits_per_pixel == 16)
    blitbitmap16(dest_x, dest_y, src_buf, src_w, src_h, fg_color, bg_color);
  else
@@ -998,9 +1177,25 @@ void Screen::clearalphamap8( uint16 x, uint16 y, uint16 w, uint16 h, uint8 opaci
         }
         buildalphamap8();
     }
+    if( lighting_style == LIGHTING_STYLE_SMOOTH && shading_light == NULL )
+    {
+        shading_light_w = (shading_rect.w - 1) / SHADING_LIGHT_STEP + 2;
+        shading_light_h = (shading_rect.h - 1) / SHADING_LIGHT_STEP + 2;
+        shading_light = (unsigned char*)malloc(sizeof(char)*shading_light_w*shading_light_h);
+        if( shading_light == NULL )
+        {
+            shading_ambient = 0xFF;
+            return;
+        }
+    }
     if( shading_ambient == 0xFF )
     {
     }
+    else if( lighting_style == LIGHTING_STYLE_SMOOTH )
+    {
+        memset( shading_light, shading_ambient, sizeof(char)*shading_light_w*shading_light_h );
+        shading_light_changed = true;
+    }
     else
     {
         memset( shading_data, shading_ambient, sizeof(char)*shading_rect.w*shading_rect.h );
@@ -1102,20 +1297,130 @@ void Screen::drawalphamap8globe( sint16 x, sint16 y, uint16 r )
     y = (y+SHADING_BORDER)*16 + 8;
 
     //Draw using "smooth" lighting
-    //The x and y are relative to (0,0) of the mapwindow itself, and are absolute coordinates, so are i and j
+    //The x and y are relative to (0,0) of the mapwindow itself, and are absolute coordinates
+    //The globe is only added at every SHADING_LIGHT_STEP pixels, where i and j are steps from its centre
     r--;
-    for(i=-globeradius_2[r];i<globeradius_2[r];i++)
-        for(j=-globeradius_2[r];j<globeradius_2[r];j++)
+    sint16 radius = globeradius_2[r];
+    x /= SHADING_LIGHT_STEP;
+    y /= SHADING_LIGHT_STEP;
+    for(i=-radius/SHADING_LIGHT_STEP;i*SHADING_LIGHT_STEP<radius;i++)
+    {
+        if( y+i < 0 || y+i >= shading_light_h )
+            continue;
+        uint8 *light = &shading_light[(y+i)*shading_light_w];
+        const uint8 *globe = &shading_globe[r][(i*SHADING_LIGHT_STEP+radius)*globeradius[r]+radius];
+        for(j=-radius/SHADING_LIGHT_STEP;j*SHADING_LIGHT_STEP<radius;j++)
         {
-            if( (y+i)-1 < 0 ||
-                (x+j)-1 < 0 ||
-                (y+i)+1 > shading_rect.h ||
-                (x+j)+1 > shading_rect.w )
+            if( x+j < 0 || x+j >= shading_light_w )
                 continue;
-            shading_data[(y+i)*shading_rect.w+(x+j)] = MIN( shading_data[(y+i)*shading_rect.w+(x+j)] + shading_globe[r][(i+globeradius_2[r])*globeradius[r]+(j+globeradius_2[r])], 255 );
+            light[x+j] = MIN( light[x+j] + globe[j*SHADING_LIGHT_STEP], 255 );
+        }
+    }
+    shading_light_changed = true;
+}
+
+/* Fill shading_data from the smooth lighting grid, interpolating bilinearly
+ * between the four nearest grid points. Pixels on the grid keep its values.
+ */
+void Screen::upsamplealphamap8()
+{
+    shading_light_changed = false;
+
+    const uint16 step_area = SHADING_LIGHT_STEP*SHADING_LIGHT_STEP;
+    uint8 *shading = shading_data;
+    for( uint16 y = 0; y < shading_rect.h; y++ )
+    {
+        const uint8 *light0 = &shading_light[(y/SHADING_LIGHT_STEP)*shading_light_w];
+        const uint8 *light1 = light0 + shading_light_w;
+        uint16 fy = y % SHADING_LIGHT_STEP;
+        for( uint16 x = 0; x < shading_rect.w; x++ )
+        {
+            uint16 lx = x / SHADING_LIGHT_STEP, fx = x % SHADING_LIGHT_STEP;
+            uint16 top = light0[lx]*(SHADING_LIGHT_STEP-fx) + light0[lx+1]*fx;
+            uint16 bottom = light1[lx]*(SHADING_LIGHT_STEP-fx) + light1[lx+1]*fx;
+            shading[x] = (top*(SHADING_LIGHT_STEP-fy) + bottom*fy + step_area/2) / step_area;
         }
+        shading += shading_rect.w;
+    }
+}
+
+/* Shade a pixel by an 8-bit light value, scaling each colour channel by
+ * light/255 rounded down.
+ */
+static inline uint32 shade_pixel(uint32 p, uint8 light)
+{
+    return ( ( ((( p & RenderSurface::Rmask ) >> RenderSurface::Rshift) * light / 255) << RenderSurface::Rshift ) | //R
+             ( ((( p & RenderSurface::Gmask ) >> RenderSurface::Gshift) * light / 255) << RenderSurface::Gshift ) | //G
+             ( ((( p & RenderSurface::Bmask ) >> RenderSurface::Bshift) * light / 255) << RenderSurface::Bshift ) ); //B
 }
 
+/* Shade a row of w 16-bit pixels by the light values in shading. */
+static void shade_row16(uint16 *pixels, const uint8 *shading, uint16 w)
+{
+    uint16 j = 0;
+#ifdef SCREEN_SHADE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i div255 = _mm_set1_epi16((short)0x8081); // (c * 0x8081) >> 23 == c / 255 for c <= 255 * 255
+    const __m128i rmask = _mm_set1_epi16(RenderSurface::Rmask >> RenderSurface::Rshift);
+    const __m128i gmask = _mm_set1_epi16(RenderSurface::Gmask >> RenderSurface::Gshift);
+    const __m128i bmask = _mm_set1_epi16(RenderSurface::Bmask >> RenderSurface::Bshift);
+    const __m128i rshift = _mm_cvtsi32_si128(RenderSurface::Rshift);
+    const __m128i gshift = _mm_cvtsi32_si128(RenderSurface::Gshift);
+    const __m128i bshift = _mm_cvtsi32_si128(RenderSurface::Bshift);
+
+    for( ; j + 8 <= w; j += 8 )
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)&pixels[j]);
+        __m128i light = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&shading[j]), zero);
+
+        __m128i r = _mm_and_si128(_mm_srl_epi16(p, rshift), rmask);
+        __m128i g = _mm_and_si128(_mm_srl_epi16(p, gshift), gmask);
+        __m128i b = _mm_and_si128(_mm_srl_epi16(p, bshift), bmask);
+        r = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(r, light), div255), 7);
+        g = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(g, light), div255), 7);
+        b = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(b, light), div255), 7);
+
+        p = _mm_or_si128(_mm_or_si128(_mm_sll_epi16(r, rshift), _mm_sll_epi16(g, gshift)), _mm_sll_epi16(b, bshift));
+        _mm_storeu_si128((__m128i *)&pixels[j], p);
+    }
+#endif
+    for( ; j < w; j++ )
+        pixels[j] = (uint16)shade_pixel(pixels[j], shading[j]);
+}
+
+/* Shade a row of w 32-bit pixels by the light values in shading. */
+static void shade_row32(uint32 *pixels, const uint8 *shading, uint16 w)
+{
+    uint16 j = 0;
+#ifdef SCREEN_SHADE_SSE2
+    // every byte is scaled, so each channel has to be a whole byte
+    if( ((RenderSurface::Rshift | RenderSurface::Gshift | RenderSurface::Bshift) & 7) == 0 )
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i div255 = _mm_set1_epi16((short)0x8081);
+        const __m128i mask = _mm_set1_epi32(RenderSurface::Rmask | RenderSurface::Gmask | RenderSurface::Bmask);
+
+        for( ; j + 4 <= w; j += 4 )
+        {
+            __m128i p = _mm_loadu_si128((const __m128i *)&pixels[j]);
+            uint32 light4;
+            memcpy(&light4, &shading[j], 4);
+            __m128i light = _mm_cvtsi32_si128(light4);
+            light = _mm_unpacklo_epi8(light, light);
+            light = _mm_unpacklo_epi16(light, light); // each light value once for every byte of its pixel
+
+            __m128i lo = _mm_unpacklo_epi8(p, zero);
+            __m128i hi = _mm_unpackhi_epi8(p, zero);
+            lo = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(lo, _mm_unpacklo_epi8(light, zero)), div255), 7);
+            hi = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(hi, _mm_unpackhi_epi8(light, zero)), div255), 7);
+
+            _mm_storeu_si128((__m128i *)&pixels[j], _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+        }
+    }
+#endif
+    for( ; j < w; j++ )
+        pixels[j] = shade_pixel(pixels[j], shading[j]);
+}
 
 void Screen::blitalphamap8(sint16 x, sint16 y, SDL_Rect *clip_rect)
 {
@@ -1139,12 +1444,15 @@ void Screen::blitalphamap8(sint16 x, sint16 y, SDL_Rect *clip_rect)
             for( i = SHADING_BORDER; i < shading_rect.w-SHADING_BORDER; i++ )
             {
                 if( shading_data[j*shading_rect.w+i] < 4 )
-                    blit(x+(i-SHADING_BORDER)*16,y+(j-SHADING_BORDER)*16,shading_tile[shading_data[j*shading_rect.w+i]],8,16,16,16,true,game->get_map_window()->get_clip_rect());
+                    blit(x+(i-SHADING_BORDER)*16,y+(j-SHADING_BORDER)*16,shading_tile[shading_data[j*shading_rect.w+i]],8,16,16,16,true,clip_rect ? clip_rect : game->get_map_window()->get_clip_rect());
             }
         }
         return;
     }
 
+    if( shading_light_changed )
+        upsamplealphamap8();
+
     uint16 src_w = shading_rect.w - (SHADING_BORDER*2*16);
     uint16 src_h = shading_rect.h - (SHADING_BORDER*2*16);
 
@@ -1237,12 +1545,7 @@ void Screen::blitalphamap8(sint16 x, sint16 y, SDL_Rect *clip_rect)
 
         for(i=0;i<src_h;i++)
         {
-            for(j=0;j<src_w;j++)
-            {
-                pixels16[j] = ( ( (unsigned char)(( (float)(( pixels16[j] & surface->Rmask ) >> surface->Rshift)) * (float)(src_buf[j])/255.0f) ) << surface->Rshift ) | //R
-                              ( ( (unsigned char)(( (float)(( pixels16[j] & surface->Gmask ) >> surface->Gshift)) * (float)(src_buf[j])/255.0f) ) << surface->Gshift ) | //G
-                              ( ( (unsigned char)(( (float)(( pixels16[j] & surface->Bmask ) >> surface->Bshift)) * (float)(src_buf[j])/255.0f) ) << surface->Bshift );  //B
-            }
+            shade_row16(pixels16, src_buf, src_w);
             pixels16 += surface->w;
             src_buf += shading_rect.w;
         }
@@ -1257,12 +1560,7 @@ void Screen::blitalphamap8(sint16 x, sint16 y, SDL_Rect *clip_rect)
 
         for(i=0;i<src_h;i++)
         {
-            for(j=0;j<src_w;j++)
-            {
-            	pixels[j] = ( ( (unsigned char)(( (float)(( pixels[j] & surface->Rmask ) >> surface->Rshift)) * (float)(src_buf[j])/255.0f) ) << surface->Rshift ) | //R
-                            ( ( (unsigned char)(( (float)(( pixels[j] & surface->Gmask ) >> surface->Gshift)) * (float)(src_buf[j])/255.0f) ) << surface->Gshift ) | //G
-                            ( ( (unsigned char)(( (float)(( pixels[j] & surface->Bmask ) >> surface->Bshift)) * (float)(src_buf[j])/255.0f) ) << surface->Bshift );  //B
-            }
+            shade_row32(pixels, src_buf, src_w);
             pixels += surface->w;
             src_buf += shading_rect.w;
         }
@@ -1364,7 +1662,7 @@ void Screen::update()
 {
  if(scaler)
   {
-   scaler->Scale(surface->format_type, surface->pixels,		// type, source
+   scaler_threads.Scale(scaler, surface->format_type, surface->pixels,		// scaler, type, source
                  0, 0, surface->w, surface->h,							// x, y, w, h
 				         surface->pitch/surface->bytes_per_pixel, surface->h,	// pixels/line, pixels/col
 				         sdl_surface->pixels,									// dest
@@ -1377,6 +1675,9 @@ void Screen::update()
     SDL_RenderClear(sdlRenderer);
     SDL_RenderCopy(sdlRenderer, sdlTexture, NULL, NULL);
     SDL_RenderPresent(sdlRenderer);
+    update_pixel_count = sdl_surface->w * sdl_surface->h;
+    full_update_pending = false;
+    num_update_rects = 0; // already uploaded
 #else
     SDL_UpdateRect(sdl_surface,0,0,0,0);
 #endif
@@ -1410,7 +1711,7 @@ void Screen::update(sint32 x, sint32 y, uint16 w, uint16 h)
 
  if(scaler)
   {
-   scaler->Scale(surface->format_type, surface->pixels,		// type, source
+   scaler_threads.Scale(scaler, surface->format_type, surface->pixels,		// scaler, type, source
                  x, y, w, h,							// x, y, w, h
                  surface->pitch/surface->bytes_per_pixel, surface->h,	// pixels/line, pixels/col
                  sdl_surface->pixels,									// dest
@@ -1438,10 +1739,134 @@ void Screen::update(sint32 x, sint32 y, uint16 w, uint16 h)
  return;
 }
 
+/* Record the palette indices of an 8-bit blit in the index buffer. The area
+ * must already be clipped to the screen.
+ */
+void Screen::index_blit(uint16 dest_x, uint16 dest_y, const unsigned char *src_buf, uint16 src_w, uint16 src_h, uint16 src_pitch, bool trans)
+{
+ if(index_buf == NULL)
+   return;
+
+ uint16 *index = index_buf + dest_y * surface->w + dest_x;
+ for(uint16 i=0;i<src_h;i++)
+   {
+    for(uint16 j=0;j<src_w;j++)
+      {
+       if(!trans || src_buf[j] != 0xff)
+         index[j] = src_buf[j];
+      }
+    src_buf += src_pitch;
+    index += surface->w;
+   }
+}
+
+/* Set an area of the index buffer to one palette index, or to
+ * SCREEN_INDEX_NONE. The area must already be clipped to the screen.
+ */
+void Screen::index_fill(uint16 index_value, uint16 x, uint16 y, uint16 w, uint16 h)
+{
+ if(index_buf == NULL)
+   return;
+
+ uint16 *index = index_buf + y * surface->w + x;
+ for(uint16 i=0;i<h;i++)
+   {
+    for(uint16 j=0;j<w;j++)
+      index[j] = index_value;
+    index += surface->w;
+   }
+}
+
+/* Redraw the pixels of one line whose palette entry has changed, widening
+ * x1-x2 to cover them. Returns true if any pixel was redrawn.
+ */
+template<class T>
+static bool resolve_palette_row(T *pixels, const uint16 *index, uint32 w, const uint32 *colour32,
+                                const uint32 *resolved_colour32, const bool *changed, uint32 &x1, uint32 &x2)
+{
+ bool resolved = false;
+ for(uint32 j=0;j<w;j++)
+   {
+    uint16 idx = index[j];
+    if(idx != SCREEN_INDEX_NONE && changed[idx] && pixels[j] == (T)resolved_colour32[idx])
+      {
+       pixels[j] = (T)colour32[idx];
+       if(j < x1) x1 = j;
+       if(j > x2) x2 = j;
+       resolved = true;
+      }
+   }
+ return resolved;
+}
+
+/* Redraw pixels whose palette entry has changed since they were drawn, in
+ * bands of 16 lines, and add the changed part of each band to the update.
+ * A pixel is only redrawn if it still has the old colour of its index, so
+ * pixels that were shaded, blended or drawn over with something other than
+ * a palette index are left alone.
+ */
+void Screen::resolve_palette()
+{
+ if(!palette_changed || index_buf == NULL)
+   return;
+ palette_changed = false;
+
+ bool changed[256];
+ bool any_changed = false;
+ for(int i=0;i<256;i++)
+   {
+    if(surface->bits_per_pixel == 16)
+      changed[i] = ((uint16)surface->colour32[i] != (uint16)resolved_colour32[i]);
+    else
+      changed[i] = (surface->colour32[i] != resolved_colour32[i]);
+    any_changed |= changed[i];
+   }
+ if(!any_changed)
+   return;
+
+ for(uint32 band_y=0;band_y<surface->h;band_y+=16)
+   {
+    uint32 band_h = MIN(16, surface->h - band_y);
+    uint32 x1 = surface->w, x2 = 0;
+    bool resolved = false;
+    for(uint32 y=band_y;y<band_y+band_h;y++)
+      {
+       const uint16 *index = index_buf + y * surface->w;
+       if(surface->bits_per_pixel == 16)
+         resolved |= resolve_palette_row((uint16 *)surface->pixels + y * surface->w, index, surface->w,
+                                         surface->colour32, resolved_colour32, changed, x1, x2);
+       else
+         resolved |= resolve_palette_row((uint32 *)surface->pixels + y * surface->w, index, surface->w,
+                                         surface->colour32, resolved_colour32, changed, x1, x2);
+      }
+    if(resolved)
+      update(x1, band_y, x2 - x1 + 1, band_h);
+   }
+
+ memcpy(resolved_colour32, surface->colour32, sizeof(resolved_colour32));
+}
+
 void Screen::preformUpdate()
 {
+ resolve_palette();
+
 #if SDL_VERSION_ATLEAST(2, 0, 0)
-    SDL_UpdateTexture(sdlTexture, NULL, sdl_surface->pixels, sdl_surface->pitch);
+    if(dirty_rect_update && !full_update_pending)
+    {
+        update_pixel_count = 0;
+        if(num_update_rects == 0)
+            return; // nothing changed, so keep presenting the last frame
+
+        merge_update_rects();
+        for(uint16 i = 0; i < num_update_rects; i++)
+            update_texture(&update_rects[i]);
+    }
+    else
+    {
+        SDL_UpdateTexture(sdlTexture, NULL, sdl_surface->pixels, sdl_surface->pitch);
+        update_pixel_count = sdl_surface->w * sdl_surface->h;
+        full_update_pending = false;
+    }
     SDL_RenderClear(sdlRenderer);
     SDL_RenderCopy(sdlRenderer, sdlTexture, NULL, NULL);
     SDL_RenderPresent(sdlRenderer);
@@ -1451,6 +1876,64 @@ void Screen::preformUpdate()
  num_update_rects = 0;
 }
 
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+/* Clip update_rects to the surface, and join rects that overlap or touch so no
+ * pixel is uploaded twice. The result replaces update_rects.
+ */
+void Screen::merge_update_rects()
+{
+    SDL_Rect bounds = { 0, 0, sdl_surface->w, sdl_surface->h };
+    uint16 n = 0;
+
+    for(uint16 i = 0; i < num_update_rects; i++)
+    {
+        SDL_Rect r = update_rects[i];
+        if(r.x < 0) { r.w += r.x; r.x = 0; }
+        if(r.y < 0) { r.h += r.y; r.y = 0; }
+        if(r.x + r.w > bounds.w) r.w = bounds.w - r.x;
+        if(r.y + r.h > bounds.h) r.h = bounds.h - r.y;
+        if(r.w > 0 && r.h > 0)
+            update_rects[n++] = r;
+    }
+
+    // keep growing rects by any rect they touch until none are left to join
+    bool merged = true;
+    while(merged)
+    {
+        merged = false;
+        for(uint16 i = 0; i < n; i++)
+        {
+            for(uint16 j = i + 1; j < n; )
+            {
+                SDL_Rect *a = &update_rects[i], *b = &update_rects[j];
+                if(b->x > a->x + a->w || a->x > b->x + b->w
+                   || b->y > a->y + a->h || a->y > b->y + b->h)
+                {
+                    j++;
+                    continue;
+                }
+                sint32 x1 = MIN(a->x, b->x), y1 = MIN(a->y, b->y);
+                sint32 x2 = MAX(a->x + a->w, b->x + b->w), y2 = MAX(a->y + a->h, b->y + b->h);
+                a->x = x1; a->y = y1; a->w = x2 - x1; a->h = y2 - y1;
+                update_rects[j] = update_rects[--n];
+                merged = true;
+            }
+        }
+    }
+
+    num_update_rects = n;
+}
+
+/* Copy one area of the scaled surface into the streaming texture. */
+void Screen::update_texture(SDL_Rect *rect)
+{
+    uint8 *pixels = (uint8 *)sdl_surface->pixels + rect->y * sdl_surface->pitch
+                    + rect->x * sdl_surface->format->BytesPerPixel;
+    SDL_UpdateTexture(sdlTexture, rect, pixels, sdl_surface->pitch);
+    update_pixel_count += rect->w * rect->h;
+}
+#endif
+
 void Screen::lock()
 {
 // SDL_LockSurface(scaled_surface);
@@ -1552,6 +2035,7 @@ bool Screen::create_sdl_surface_and_texture(sint32 w, sint32 h, Uint32 format)
         return false;
     }
 
+    full_update_pending = true;
     return true;
 }
 
@@ -1971,17 +2455,40 @@ unsigned char *Screen::copy_area32(SDL_Rect *area, uint16 down_scale)
 
 // surface -> unsigned char *
 // (NULL area = entire screen)
+// With an index buffer the area's palette indices follow the pixels, so
+// restore_area() can put them back too.
 unsigned char *Screen::copy_area(SDL_Rect *area, unsigned char *buf)
 {
     SDL_Rect screen_area = { 0, 0, (uint16)surface->w, (uint16)surface->h };
     if(!area)
         area = &screen_area;
 
+    uint32 pixels_size = area->w * area->h * surface->bytes_per_pixel;
+    if(buf == NULL)
+        buf = (unsigned char *)malloc(pixels_size + (index_buf ? area->w * area->h * sizeof(uint16) : 0));
+
+    if(index_buf)
+        copy_index_area(area, (uint16 *)(buf + pixels_size));
+
     if(surface->bits_per_pixel == 16)
         return(copy_area16(area, buf));
     return(copy_area32(area, buf));
 }
 
+// index_buf -> uint16 *, clipped like copy_area16/32()
+void Screen::copy_index_area(SDL_Rect *area, uint16 *dest)
+{
+    sint32 x1 = MAX(area->x, 0), y1 = MAX(area->y, 0);
+    sint32 x2 = MIN(area->x + area->w, (sint32)surface->w), y2 = MIN(area->y + area->h, (sint32)surface->h);
+
+    for(sint32 y = y1; y < y2; y++)
+    {
+        const uint16 *src = index_buf + y * surface->w;
+        for(sint32 x = x1; x < x2; x++)
+            dest[(y - area->y) * area->w + (x - area->x)] = src[x];
+    }
+}
+
 
 // unsigned char * -> surface
 // unsigned char * -> target (src area still means location on screen, not relative to target)
@@ -1993,6 +2500,13 @@ void Screen::restore_area(unsigned char *pixels, SDL_Rect *area,
     if(!area)
         area = &screen_area;
 
+    if(index_buf && !target)
+    {
+        const uint16 *index = (const uint16 *)(pixels + area->w * area->h * surface->bytes_per_pixel);
+        for(uint16 i = 0; i < area->h; i++)
+            memcpy(index_buf + (area->y + i) * surface->w + area->x, index + i * area->w, area->w * sizeof(uint16));
+    }
+
     if(surface->bits_per_pixel == 16)
         restore_area16(pixels, area, target, target_area, free_src);
     else
@@ -2159,6 +2673,15 @@ void Screen::draw_line (int sx, int sy, int ex, int ey, uint8 color)
 
 	surface->draw_line(sx, sy, ex, ey, color);
 
+	if(index_buf)
+	{
+		// the line's pixels aren't known here, so give up on its bounding box
+		sint32 x1 = MAX(MIN(sx, ex), 0), y1 = MAX(MIN(sy, ey), 0);
+		sint32 x2 = MIN(MAX(sx, ex) + 1, (sint32)surface->w), y2 = MIN(MAX(sy, ey) + 1, (sint32)surface->h);
+		if(x1 < x2 && y1 < y2)
+			index_fill(SCREEN_INDEX_NONE, x1, y1, x2 - x1, y2 - y1);
+	}
+
 	return;
 }
 
@@ -30,11 +30,14 @@
 #include "Game.h"
 #include "Surface.h"
 #include "Scale.h"
+#include "TileManager.h"
 
 #define LIGHTING_STYLE_NONE 0
 #define LIGHTING_STYLE_SMOOTH 1
 #define LIGHTING_STYLE_ORIGINAL 2
 
+#define SCREEN_INDEX_NONE 0x100 // index_buf value for pixels resolve_palette() must leave alone
+
 class Configuration;
 
 class Screen
@@ -50,6 +53,7 @@ class Screen
 #endif
  ScalerRegistry		scaler_reg;		// Scaler Registry
  const ScalerStruct	*scaler;		// Scaler
+ ScalerThreadPool	scaler_threads;	// Threads running the scaler
  int scaler_index;	// Index of Current Scaler
  int scale_factor;	// Scale factor
 
@@ -64,9 +68,20 @@ class Screen
  SDL_Rect *update_rects;
  uint16 num_update_rects;
  uint16 max_update_rects;
+ bool dirty_rect_update; // only upload update_rects to the SDL2 texture
+ bool full_update_pending; // texture contents are invalid, upload everything
+ uint32 update_pixel_count; // pixels uploaded by the last preformUpdate()
+ uint16 *index_buf; // palette index of each pixel, or SCREEN_INDEX_NONE if it wasn't drawn from the palette. NULL unless indexed_framebuffer is set
+ uint32 resolved_colour32[256]; // palette that the indexed pixels were last drawn with
+ bool palette_changed; // colour32 has changed since the last palette resolve
+ uint32 palette_revision; // incremented whenever colour32 changes
+ uint32 palette_set_revision; // incremented when colour32 changes other than by cycling
 
  SDL_Rect shading_rect;
  uint8 *shading_data;
+ uint8 *shading_light; // smooth lighting at every SHADING_LIGHT_STEP pixels, upsampled into shading_data
+ uint16 shading_light_w, shading_light_h;
+ bool shading_light_changed; // shading_data has to be upsampled again
  uint8 *shading_globe[6];
  uint8 shading_ambient;
  uint8 *shading_tile[4];
@@ -86,6 +101,8 @@ class Screen
    bool set_palette(uint8 *palette);
    bool set_palette_entry(uint8 idx, uint8 r, uint8 g, uint8 b);
    bool rotate_palette(uint8 pos, uint8 length);
+   uint32 get_palette_revision() { return palette_revision; }
+   bool is_indexed() { return index_buf != NULL; }
    bool clear(sint16 x, sint16 y, sint16 w, sint16 h,SDL_Rect *clip_rect=NULL);
    void *get_pixels();
    const unsigned char *get_surface_pixels() { return(surface->get_pixels()); }
@@ -107,6 +124,7 @@ class Screen
    void put_pixel(uint8 colour_num, uint16 x, uint16 y);
 
    bool blit(sint32 dest_x, sint32 dest_y, unsigned char *src_buf, uint16 src_bpp, uint16 src_w, uint16 src_h, uint16 src_pitch, bool trans=false, SDL_Rect *clip_rect=NULL, uint8 opacity=255);
+   bool blit_tile(sint32 dest_x, sint32 dest_y, const Tile *tile, NativeTile *native, SDL_Rect *clip_rect=NULL);
    void blitbitmap(uint16 dest_x, uint16 dest_y, const unsigned char *src_buf, uint16 src_w, uint16 src_h, uint8 fg_color, uint8 bg_color);
 
    void buildalphamap8();
@@ -124,6 +142,7 @@ class Screen
    void update();
    void update(sint32 x, sint32 y, uint16 w, uint16 h);
    void preformUpdate();
+   uint32 get_update_pixel_count() { return update_pixel_count; }
    void lock();
    void unlock();
 
@@ -171,6 +190,7 @@ inline void blitbitmap32(uint16 dest_x, uint16 dest_y, const unsigned char *src_
 
    unsigned char *copy_area16(SDL_Rect *area, unsigned char *buf);
    unsigned char *copy_area32(SDL_Rect *area, unsigned char *buf);
+   void copy_index_area(SDL_Rect *area, uint16 *dest);
    void restore_area16(unsigned char *pixels, SDL_Rect *area, unsigned char *target = NULL, SDL_Rect *target_area = NULL, bool free_src = true);
    void restore_area32(unsigned char *pixels, SDL_Rect *area, unsigned char *target = NULL, SDL_Rect *target_area = NULL, bool free_src = true);
 
@@ -184,7 +204,15 @@ bool try_scaler(int w, int h, uint32 flags, int hwdepth);
 private:
     int get_screen_bpp();
 
+    void index_blit(uint16 dest_x, uint16 dest_y, const unsigned char *src_buf, uint16 src_w, uint16 src_h, uint16 src_pitch, bool trans);
+    void index_fill(uint16 index_value, uint16 x, uint16 y, uint16 w, uint16 h);
+    void resolve_palette();
+    void build_native_tile(const Tile *tile, NativeTile *native);
+    void upsamplealphamap8();
+
 #if SDL_VERSION_ATLEAST(2, 0, 0)
+    void merge_update_rects();
+    void update_texture(SDL_Rect *rect);
     bool init_sdl2_window(uint16 scale);
     bool create_sdl_surface_and_texture(sint32 w, sint32 h, Uint32 format);
 #else
@@ -23,6 +23,7 @@
 
 #include <list>
 #include <stack>
+#include <unordered_map>
 #include <cassert>
 #include "nuvieDefs.h"
 #include "Configuration.h"
@@ -115,24 +116,16 @@ An actor schedule entry
 
 extern bool nscript_new_actor_var(lua_State *L, uint16 actor_num);
 
-struct ScriptObjRef
-{
-   uint16 refcount;
-   iAVLKey key;
+// number of Lua Obj variables holding each object
+static std::unordered_map<Obj *, uint16> script_obj_refs;
 
-   ScriptObjRef()
-   {
-      refcount = 0;
-      key = -1;
-   };
-};
+// Registry key of the Obj variable cache. It maps each object to its Lua
+// variable, and has weak values so cached variables can still be collected.
+static char nscript_obj_cache_key;
 
-static iAVLTree *script_obj_list;
-
-static iAVLKey get_iAVLKey(const void *item)
-{
-   return ((ScriptObjRef *)item)->key;
-}
+// script object statistics, shown by print_gc_stats()
+static uint32 script_obj_vars_created = 0;
+static uint32 script_obj_var_cache_hits = 0;
 
 static NuvieIO *g_objlist_file = NULL;
 
@@ -572,11 +565,16 @@ Script::Script(Configuration *cfg, GUI *gui, SoundManager *sm, nuvie_game_t type
    script = this;
    soundManager = sm;
 
-   script_obj_list = iAVLAllocTree(get_iAVLKey);
-
    L = luaL_newstate();
    luaL_openlibs(L);
 
+   lua_newtable(L); // Obj variable cache
+   lua_newtable(L);
+   lua_pushstring(L, "v");
+   lua_setfield(L, -2, "__mode");
+   lua_setmetatable(L, -2);
+   lua_rawsetp(L, LUA_REGISTRYINDEX, &nscript_obj_cache_key);
+
    luaL_newmetatable(L, "nuvie.U6Link");
    luaL_register(L, NULL, nscript_u6linklib_m);
 
@@ -934,6 +932,19 @@ Script::~Script()
       lua_close(L);
 }
 
+/* Show how much memory the Lua state is using and how often Obj variables
+ * are reused, on the console.
+ */
+void Script::print_gc_stats()
+{
+   uint32 total = script_obj_vars_created + script_obj_var_cache_hits;
+
+   ConsoleAddInfo("Script memory: %d KB", lua_gc(L, LUA_GCCOUNT, 0));
+   ConsoleAddInfo("Script objects: %d referenced, %d variables created, %d reused (%d%%)",
+                  (sint32)script_obj_refs.size(), script_obj_vars_created, script_obj_var_cache_hits,
+                  total ? (sint32)(script_obj_var_cache_hits * 100.0f / total) : 0);
+}
+
 bool Script::init()
 {
 	std::string dir, path;
@@ -1717,9 +1728,23 @@ Obj *nscript_get_obj_from_args(lua_State *L, int lua_stack_offset)
 	   return *s_obj;
 }
 
+/* Push the Lua variable for `obj'. An object keeps the same variable while
+ * the script engine holds on to it, so only the first push allocates.
+ */
 void nscript_new_obj_var(lua_State *L, Obj *obj)
 {
 	Obj **p_obj;
+
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &nscript_obj_cache_key);
+	lua_rawgetp(L, -1, obj);
+	if(!lua_isnil(L, -1))
+	{
+		lua_remove(L, -2); // cache table
+		script_obj_var_cache_hits++;
+		return;
+	}
+	lua_pop(L, 1);
+
     p_obj = (Obj **)lua_newuserdata(L, sizeof(Obj *));
 
     luaL_getmetatable(L, "nuvie.Obj");
@@ -1728,6 +1753,11 @@ void nscript_new_obj_var(lua_State *L, Obj *obj)
     *p_obj = obj;
 
     nscript_inc_obj_ref_count(obj);
+    script_obj_vars_created++;
+
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, -3, obj);
+    lua_remove(L, -2); // cache table
 }
 
 /***
@@ -1752,79 +1782,64 @@ static int nscript_obj_newobj(lua_State *L)
 
 int nscript_obj_new(lua_State *L, Obj *obj)
 {
-   Obj **p_obj;
-
-   p_obj = (Obj **)lua_newuserdata(L, sizeof(Obj *));
-
-   luaL_getmetatable(L, "nuvie.Obj");
-   lua_setmetatable(L, -2);
-
    if(obj == NULL)
    {
       obj = new Obj();
 
-      if(lua_gettop(L) > 1) // do we have arguments?
+      if(lua_gettop(L) > 0) // do we have arguments?
       {
          if(lua_isuserdata(L, 1)) // do we have an obj
          {
             if(nscript_obj_init_from_obj(L, obj) == false)
+            {
+               delete obj;
                return 0;
+            }
          }
          else // init object from arguments
          {
-            if(nscript_obj_init_from_args(L, lua_gettop(L) - 1, obj) == false)
+            if(nscript_obj_init_from_args(L, lua_gettop(L), obj) == false)
+            {
+               delete obj;
                return 0;
+            }
          }
       }
    }
 
-   *p_obj = obj;
-
-   nscript_inc_obj_ref_count(obj);
+   nscript_new_obj_var(L, obj);
 
    return 1;
 }
 
 sint32 nscript_inc_obj_ref_count(Obj *obj)
 {
-   ScriptObjRef *obj_ref;
-   iAVLKey key = (iAVLKey)obj;
+   uint16 &refcount = script_obj_refs[obj];
 
-   obj_ref = (ScriptObjRef *)iAVLSearch(script_obj_list, key);
-   if(obj_ref == NULL)
-   {
+   if(refcount == 0)
       obj->set_in_script(true); // mark as being used by script engine.
-      obj_ref =  new ScriptObjRef();
-      obj_ref->key = (iAVLKey)obj;
-      iAVLInsert(script_obj_list, obj_ref);
-   }
 
-   obj_ref->refcount++;
+   refcount++;
 
-   return (sint32)obj_ref->refcount;
+   return (sint32)refcount;
 }
 
 sint32 nscript_dec_obj_ref_count(Obj *obj)
 {
-   ScriptObjRef *obj_ref;
-   iAVLKey key = (iAVLKey)obj;
-
-   obj_ref = (ScriptObjRef *)iAVLSearch(script_obj_list, key);
-   if(obj_ref == NULL)
+   std::unordered_map<Obj *, uint16>::iterator obj_ref = script_obj_refs.find(obj);
+   if(obj_ref == script_obj_refs.end())
       return -1;
 
+   obj_ref->second--;
 
-   obj_ref->refcount--;
-
-   if(obj_ref->refcount == 0)
+   if(obj_ref->second == 0)
    {
-      iAVLDelete(script_obj_list, key);
-      delete obj_ref;
+      script_obj_refs.erase(obj_ref);
       obj->set_in_script(false); //nolonger being referenced by the script engine.
       return 0;
    }
 
-   return obj_ref->refcount;
+   return obj_ref->second;
 }
 
 inline bool nscript_obj_init_from_obj(lua_State *L, Obj *s_obj)
@@ -1995,12 +2010,16 @@ static int nscript_obj_set(lua_State *L)
    if(!strcmp(key, "obj_n"))
    {
       obj->obj_n = (uint16)lua_tointeger(L, 3);
+      if(obj->is_on_map())
+         Game::get_game()->get_obj_manager()->invalidate_passable(obj);
       return 0;
    }
 
    if(!strcmp(key, "frame_n"))
    {
       obj->frame_n = (uint8)lua_tointeger(L, 3);
+      if(obj->is_on_map())
+         Game::get_game()->get_obj_manager()->invalidate_passable(obj);
       return 0;
    }
 
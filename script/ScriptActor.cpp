@@ -159,6 +159,7 @@ static int nscript_actor_set_talk_flag(lua_State *L);
 static int nscript_actor_clear_talk_flag(lua_State *L);
 static int nscript_actor_get_number_of_schedules(lua_State *L);
 static int nscript_actor_get_schedule(lua_State *L);
+static int nscript_actor_get_props(lua_State *L);
 
 static const struct luaL_Reg nscript_actorlib_f[] =
 {
@@ -196,6 +197,7 @@ static const struct luaL_Reg nscript_actorlib_f[] =
    { "clear_talk_flag", nscript_actor_clear_talk_flag },
    { "get_number_of_schedules", nscript_actor_get_number_of_schedules },
    { "get_schedule", nscript_actor_get_schedule },
+   { "get_props", nscript_actor_get_props },
 
    { NULL, NULL }
 };
@@ -463,11 +465,18 @@ int (*actor_get_func[])(Actor *, lua_State *) =
 
 static int nscript_map_get_actor(lua_State *L);
 static int nscript_update_actor_schedules(lua_State *L);
+static int nscript_actors_ready_to_move(lua_State *L);
 
 static int nscript_actor_inv(lua_State *L);
 
+// Registry key of the Actor variable cache, indexed by actor number.
+static char nscript_actor_cache_key;
+
 void nscript_init_actor(lua_State *L)
 {
+   lua_createtable(L, ACTORMANAGER_MAX_ACTORS, 0);
+   lua_rawsetp(L, LUA_REGISTRYINDEX, &nscript_actor_cache_key);
+
    luaL_newmetatable(L, "nuvie.Actor");
 
    luaL_register(L, NULL, nscript_actorlib_m);
@@ -480,14 +489,29 @@ void nscript_init_actor(lua_State *L)
    lua_pushcfunction(L, nscript_update_actor_schedules);
    lua_setglobal(L, "update_actor_schedules");
 
+   lua_pushcfunction(L, nscript_actors_ready_to_move);
+   lua_setglobal(L, "actors_ready_to_move");
+
    lua_pushcfunction(L, nscript_actor_inv);
    lua_setglobal(L, "actor_inventory");
 }
 
+/* Push the Lua variable for actor `actor_num'. Each actor number only gets one
+ * variable, which is kept in the registry and reused.
+ */
 bool nscript_new_actor_var(lua_State *L, uint16 actor_num)
 {
    uint16 *userdata;
 
+   lua_rawgetp(L, LUA_REGISTRYINDEX, &nscript_actor_cache_key);
+   lua_rawgeti(L, -1, actor_num);
+   if(!lua_isnil(L, -1))
+   {
+      lua_remove(L, -2); // cache table
+      return true;
+   }
+   lua_pop(L, 1);
+
    userdata = (uint16 *)lua_newuserdata(L, sizeof(uint16));
 
    luaL_getmetatable(L, "nuvie.Actor");
@@ -495,6 +519,10 @@ bool nscript_new_actor_var(lua_State *L, uint16 actor_num)
 
    *userdata = actor_num;
 
+   lua_pushvalue(L, -1);
+   lua_rawseti(L, -3, actor_num);
+   lua_remove(L, -2); // cache table
+
    return true;
 }
 
@@ -1823,6 +1851,40 @@ static int nscript_update_actor_schedules(lua_State *L)
 	return 0;
 }
 
+/***
+Get the actors on a map level that can take a turn. These are the living
+actors on the level with movement points left and a worktype, that aren't
+asleep or paralyzed. This saves the turn loop from checking every actor
+through the Actor variables.
+@function actors_ready_to_move
+@int z map level
+@treturn table array of Actor, in actor number order
+@within Actor
+ */
+static int nscript_actors_ready_to_move(lua_State *L)
+{
+   ActorManager *actor_manager = Game::get_game()->get_actor_manager();
+   uint8 z = (uint8)lua_tointeger(L, 1);
+   int n = 0;
+
+   lua_newtable(L);
+
+   for(uint16 i = 0; i < ACTORMANAGER_MAX_ACTORS; i++)
+   {
+      Actor *actor = actor_manager->get_actor((uint8)i);
+
+      if(actor->get_obj_n() == 0 || actor->get_z() != z || actor->get_moves_left() <= 0
+         || actor->is_paralyzed() || actor->is_sleeping() || actor->get_worktype() == 0
+         || actor->is_alive() == false)
+         continue;
+
+      nscript_new_actor_var(L, i);
+      lua_rawseti(L, -2, ++n);
+   }
+
+   return 1;
+}
+
 /***
 Iterate through objects in the actor's inventory.
 @function actor_inventory
@@ -1967,4 +2029,40 @@ static int nscript_actor_get_schedule(lua_State *L)
    lua_settable(L, -3);
 
    return 1;
-}
\ No newline at end of file
+}
+
+/***
+Get several Actor variables in one call.
+@function Actor.get_props
+@tparam Actor actor
+@string ... names of the variables to get
+@return the value of each variable in the same order, nil for unknown names
+@usage
+   local x, y, mpts = Actor.get_props(actor, "x", "y", "mpts")
+@within Actor
+ */
+static int nscript_actor_get_props(lua_State *L)
+{
+   Actor *actor;
+   int nargs = lua_gettop(L);
+
+   actor = nscript_get_actor_from_args(L);
+   if(actor == NULL)
+      return 0;
+
+   luaL_checkstack(L, nargs, "too many Actor variables");
+
+   for(int i = 2; i <= nargs; i++)
+   {
+      const char *key = lua_tostring(L, i);
+      int idx = -1;
+
+      if(key != NULL)
+         idx = str_bsearch(actor_get_vars, sizeof(actor_get_vars) / sizeof(actor_get_vars[0]), (char *)key);
+
+      if(idx == -1 || (*actor_get_func[idx])(actor, L) == 0)
+         lua_pushnil(L);
+   }
+
+   return nargs - 1;
+}
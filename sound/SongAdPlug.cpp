@@ -38,7 +38,11 @@ SongAdPlug::SongAdPlug(Audio::Mixer *m, CEmuopl *o) {
 }
 
 SongAdPlug::~SongAdPlug() {
- //delete player;
+ if(stream)
+ {
+   mixer->stopHandle(handle);
+   delete stream; // stops its decoding thread, which uses opl
+ }
 }
 
 bool SongAdPlug::Init(const char *filename, uint16 song_num) {
@@ -55,6 +59,7 @@ bool SongAdPlug::Init(const char *filename, uint16 song_num) {
 bool SongAdPlug::Play(bool looping) {
     if(stream)
     {
+    	stream->start_decoding();
     	mixer->playStream(Audio::Mixer::kMusicSoundType, &handle, stream, -1, Audio::Mixer::kMaxChannelVolume, 0, DisposeAfterUse::NO);
     }
 	return true;
@@ -104,6 +104,9 @@ public:
 
 SoundManager::~SoundManager ()
 {
+  // the playing song's decoding thread uses opl, so stop it first
+  musicStop();
+
   //thanks to wjp for this one
   while (!m_Songs.empty ())
     {
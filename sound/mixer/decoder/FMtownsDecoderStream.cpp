@@ -33,41 +33,34 @@ FMtownsDecoderStream::FMtownsDecoderStream(unsigned char *buf, uint32 len)
 	buf_len = len;
 	buf_pos = 0;
 	should_free_raw_data = false;
+	cache_item = NULL;
 }
 
 FMtownsDecoderStream::FMtownsDecoderStream(std::string filename, uint16 sample_num, bool isCompressed)
 {
-	 unsigned char *item_data;
-	 uint32 decomp_size;
-	 U6Lib_n sam_file;
-	 U6Lzw lzw;
+	 // decoded samples are shared through the library cache, so replaying a sound doesn't decode it again.
+	 cache_item = U6LibCache::get_cache()->get_item(filename, sample_num, isCompressed ? U6LIB_ITEM_LZW : U6LIB_ITEM_RAW);
 
-	 sam_file.open(filename, 4);
-
-	 item_data = sam_file.get_item(sample_num, NULL);
-
-	 if(isCompressed)
+	 if(cache_item)
 	 {
-		 raw_audio_buf = lzw.decompress_buffer(item_data, sam_file.get_item_size(sample_num), decomp_size);
-
-		 free(item_data);
-
-		 buf_len = decomp_size;
+		 raw_audio_buf = cache_item->data;
+		 buf_len = cache_item->size;
 	 }
 	 else
 	 {
-		 raw_audio_buf = item_data;
-		 buf_len = sam_file.get_item_size(sample_num);
+		 raw_audio_buf = NULL;
+		 buf_len = 0;
 	 }
 
 	 buf_pos = 0;
-	 should_free_raw_data = true;
+	 should_free_raw_data = false;
 }
 
 FMtownsDecoderStream::~FMtownsDecoderStream()
 {
 	if(raw_audio_buf && should_free_raw_data)
 		free(raw_audio_buf);
+	U6LibCache::get_cache()->release(cache_item);
 }
 
 uint32 FMtownsDecoderStream::getLengthInMsec()
@@ -30,12 +30,14 @@ class NuvieIOBuffer;
 
 using std::string;
 
+struct U6LibCacheItem;
+
 class FMtownsDecoderStream : public Audio::RewindableAudioStream
 {
 public:
 	FMtownsDecoderStream()
 	{
-	should_free_raw_data = false; raw_audio_buf = NULL;
+	should_free_raw_data = false; raw_audio_buf = NULL; cache_item = NULL;
 	}
 
 	FMtownsDecoderStream(unsigned char *buf, uint32 len);
@@ -67,6 +69,7 @@ protected:
 
 	bool should_free_raw_data;
 	unsigned char *raw_audio_buf;
+	U6LibCacheItem *cache_item; // holds raw_audio_buf when it came from the sam file
 	uint32 buf_len;
 	uint32 buf_pos;
     
@@ -25,6 +25,10 @@
 
 #include "U6AdPlugDecoderStream.h"
 
+#define MUSIC_RENDER_AHEAD_MS 500 // at least this much music is kept decoded ahead of the mixer
+#define MUSIC_DECODE_CHUNK 4096 // samples decoded at a time, so the thread stops quickly
+#define MUSIC_DECODE_POLL_MS 10 // how long the thread sleeps while the ring is full
+
 
 U6AdPlugDecoderStream::U6AdPlugDecoderStream(CEmuopl *o, std::string filename, uint16 song_num)
 {
@@ -46,13 +50,135 @@ U6AdPlugDecoderStream::U6AdPlugDecoderStream(CEmuopl *o, std::string filename, u
 
   interrupt_rate = (int)(opl->getRate() / 60);
   interrupt_samples_left = interrupt_rate;
+
+  ring_size = 1;
+  while(ring_size < (uint32)opl->getRate() * 2 * MUSIC_RENDER_AHEAD_MS / 1000)
+    ring_size <<= 1;
+  ring = new sint16[ring_size];
+  ring_write = ring_read = 0;
+  decoding = false;
+  decode_thread = NULL;
+  render_ahead = false;
 }
 
 U6AdPlugDecoderStream::~U6AdPlugDecoderStream()
 {
+  stop_decoding();
+  delete[] ring;
 }
 
+/* Copy music decoded ahead by the decoding thread. If the thread has fallen
+ * behind, the rest of the buffer is silent rather than waiting for it.
+ */
 int U6AdPlugDecoderStream::readBuffer(sint16 *buffer, const int numSamples)
+{
+ if(!render_ahead)
+   return decode(buffer, numSamples);
+
+ uint32 read = ring_read.load(std::memory_order_relaxed);
+
+ uint32 len = (uint32)numSamples;
+ uint32 available = ring_write.load(std::memory_order_acquire) - read;
+ if(len > available)
+   len = available & ~1; // keep the channels in step
+
+ uint32 pos = read & (ring_size - 1);
+ uint32 first = MIN(len, ring_size - pos);
+ memcpy(buffer, &ring[pos], first * sizeof(sint16));
+ memcpy(buffer + first, ring, (len - first) * sizeof(sint16));
+ if(len < (uint32)numSamples)
+   memset(buffer + len, 0, (numSamples - len) * sizeof(sint16));
+
+ ring_read.store(read + len, std::memory_order_release);
+
+ return numSamples;
+}
+
+/* Rewind the song, stopping the decoding thread first so it isn't using the
+ * player. The mixer must have stopped reading the stream already (stopHandle()
+ * waits for that), so the music decoded ahead can simply be dropped.
+ */
+bool U6AdPlugDecoderStream::rewind()
+{
+ if(player == NULL)
+   return false;
+
+ stop_decoding();
+ player->rewind(); //FIXME this would need to be locked if called outside mixer thread without render_ahead.
+
+ ring_write = ring_read = 0;
+
+ return true;
+}
+
+void U6AdPlugDecoderStream::start_decoding()
+{
+ if(decode_thread != NULL)
+   return;
+
+ decoding = true;
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+ decode_thread = SDL_CreateThread(decode_thread_func, "Music Decode Thread", this);
+#else
+ decode_thread = SDL_CreateThread(decode_thread_func, this);
+#endif
+ if(decode_thread == NULL)
+   {
+    DEBUG(0,LEVEL_WARNING,"Couldn't start the music decoding thread, decoding in the mixer instead\n");
+    return;
+   }
+
+ render_ahead = true;
+}
+
+void U6AdPlugDecoderStream::stop_decoding()
+{
+ if(decode_thread == NULL)
+   return;
+
+ decoding = false;
+ SDL_WaitThread(decode_thread, NULL);
+ decode_thread = NULL;
+ render_ahead = false;
+}
+
+/* Keep the ring topped up until decoding is cleared. It is only refilled once
+ * a quarter of it has been played, so small reads don't wake it every time.
+ */
+int U6AdPlugDecoderStream::decode_thread_func(void *data)
+{
+ U6AdPlugDecoderStream *stream = (U6AdPlugDecoderStream *)data;
+
+ while(stream->decoding.load())
+   {
+    uint32 used = stream->ring_write.load(std::memory_order_relaxed) - stream->ring_read.load(std::memory_order_acquire);
+    if(stream->ring_size - used < stream->ring_size / 4)
+      SDL_Delay(MUSIC_DECODE_POLL_MS);
+    else
+      stream->fill_ring(MUSIC_DECODE_CHUNK);
+   }
+
+ return 0;
+}
+
+/* Decode up to max_samples into the free space in the ring, stopping at the
+ * end of the buffer.
+ */
+void U6AdPlugDecoderStream::fill_ring(uint32 max_samples)
+{
+ uint32 write = ring_write.load(std::memory_order_relaxed);
+ uint32 space = ring_size - (write - ring_read.load(std::memory_order_acquire));
+ uint32 pos = write & (ring_size - 1);
+ uint32 len = MIN(MIN(max_samples, space), ring_size - pos) & ~1;
+
+ if(len == 0)
+   return;
+
+ decode(&ring[pos], len);
+ ring_write.store(write + len, std::memory_order_release);
+}
+
+int U6AdPlugDecoderStream::decode(sint16 *buffer, const int numSamples)
 {
  sint32 i, j;
  short *data = (short *)buffer;
@@ -21,6 +21,7 @@
 #include <cstdio>
 #include <string>
 #include <list>
+#include <atomic>
 
 #include "SDL.h"
 #include "audiostream.h"
@@ -41,6 +42,8 @@ public:
 	U6AdPlugDecoderStream()
 	{
 	opl = NULL; player = NULL; player_refresh_count = 0;
+	ring = NULL; ring_size = 0; ring_write = ring_read = 0;
+	decoding = false; decode_thread = NULL; render_ahead = false;
 	}
 
 	U6AdPlugDecoderStream(CEmuopl *o, std::string filename, uint16 song_num);
@@ -54,7 +57,10 @@ public:
 	/** Sample rate of the stream. */
 	int getRate() const { return opl->getRate(); }
 
-	bool rewind() { if(player) { player->rewind(); return true; } return false; } //FIXME this would need to be locked if called outside mixer thread.
+	bool rewind();
+
+	/* Render music ahead of the mixer on a background thread until rewind(). */
+	void start_decoding();
 
 	/**
 	 * End of data reached? If this returns true, it means that at this
@@ -65,7 +71,11 @@ public:
 	 */
 	bool endOfData() const { return false; }
 private:
+	int decode(sint16 *buffer, const int numSamples);
 	void update_opl(short *data, int num_samples);
+	void fill_ring(uint32 max_samples);
+	void stop_decoding();
+	static int decode_thread_func(void *data);
 protected:
 
 	uint16 samples_left;
@@ -75,6 +85,14 @@ protected:
 	int interrupt_rate;
 	int interrupt_samples_left;
 	bool is_midi_track;
+
+	sint16 *ring; // music rendered ahead by decode_thread, for readBuffer() to copy
+	uint32 ring_size; // in samples, a power of two
+	std::atomic<uint32> ring_write; // samples written, only changed by the decoding thread
+	std::atomic<uint32> ring_read; // samples read, only changed by readBuffer()
+	std::atomic<bool> decoding; // cleared to stop decode_thread
+	SDL_Thread *decode_thread;
+	std::atomic<bool> render_ahead; // set while decode_thread is running, otherwise readBuffer() decodes
 };
 
 #endif /* __U6AdPlugDecoderStream_h__ */
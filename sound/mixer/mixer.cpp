@@ -165,7 +165,7 @@ private:
 
 
 MixerImpl::MixerImpl(uint32 sampleRate)
-	: _sampleRate(sampleRate), _mixerReady(false), _handleSeed(0) {
+	: _sampleRate(sampleRate), _mixerReady(false), _handleSeed(0), _mixingSlot(-1), _commandHead(0), _commandTail(0) {
 
 	assert(sampleRate > 0);
 
@@ -174,11 +174,20 @@ MixerImpl::MixerImpl(uint32 sampleRate)
 	for (i = 0; i < ARRAYSIZE(_volumeForSoundType); i++)
 		_volumeForSoundType[i] = kMaxMixerVolume;
 
-	for (i = 0; i != NUM_CHANNELS; i++)
+	for (i = 0; i != NUM_CHANNELS; i++) {
 		_channels[i] = 0;
+		_slots[i].handle = 0xFFFFFFFF;
+		_slotEnded[i] = 0xFFFFFFFF;
+		_slotElapsed[i] = 0;
+		_slotReleased[i] = 0xFFFFFFFF;
+	}
 }
 
 MixerImpl::~MixerImpl() {
+	// The audio callback has stopped by now, so apply anything still queued
+	// to free the channels it carries.
+	processCommands();
+
 	for (int i = 0; i != NUM_CHANNELS; i++)
 		delete _channels[i];
 }
@@ -191,10 +200,138 @@ uint32 MixerImpl::getOutputRate() const {
 	return _sampleRate;
 }
 
-void MixerImpl::insertChannel(SoundHandle *handle, Channel *chan) {
+int MixerImpl::findSlot(SoundHandle handle) const {
+	const int index = handle._val % NUM_CHANNELS;
+	if (_slots[index].handle != handle._val || !isSlotActive(index))
+		return -1;
+	return index;
+}
+
+bool MixerImpl::isSlotActive(int slot) const {
+	return _slots[slot].handle != 0xFFFFFFFF && _slotEnded[slot].load(std::memory_order_acquire) != _slots[slot].handle;
+}
+
+void MixerImpl::freeSlot(int slot) {
+	_slots[slot].handle = 0xFFFFFFFF;
+}
+
+/**
+ * Queue a command for the audio thread. If the queue is full this waits for
+ * the audio thread to catch up.
+ */
+void MixerImpl::postCommand(CommandType type, int slot, uint32 handle, int value, Channel *chan) {
+	const uint32 head = _commandHead.load(std::memory_order_relaxed);
+
+	if (head - _commandTail.load(std::memory_order_acquire) == COMMAND_QUEUE_SIZE)
+		waitForCommands();
+
+	Command &cmd = _commands[head & (COMMAND_QUEUE_SIZE - 1)];
+	cmd.type = type;
+	cmd.slot = slot;
+	cmd.handle = handle;
+	cmd.value = value;
+	cmd.chan = chan;
+
+	_commandHead.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * Wait until the audio thread has applied every queued command. Without a
+ * running audio callback the commands are applied here instead.
+ */
+void MixerImpl::waitForCommands() {
+	while (_commandTail.load(std::memory_order_acquire) != _commandHead.load(std::memory_order_relaxed)) {
+		if (!_mixerReady) {
+			processCommands();
+			break;
+		}
+		SDL_Delay(1);
+	}
+}
+
+/**
+ * Apply the queued commands to the channels. Called by the audio thread, or
+ * by the calling thread while the audio device is closed.
+ */
+void MixerImpl::processCommands() {
+	const uint32 head = _commandHead.load(std::memory_order_acquire);
+	uint32 tail = _commandTail.load(std::memory_order_relaxed);
+
+	for (; tail != head; tail++) {
+		const Command &cmd = _commands[tail & (COMMAND_QUEUE_SIZE - 1)];
+		Channel *chan = (cmd.slot >= 0) ? _channels[cmd.slot] : 0;
+
+		// commands for a single channel are ignored once it has gone
+		if (cmd.slot >= 0 && cmd.type != kPlayCommand && (!chan || chan->getHandle()._val != cmd.handle))
+			continue;
+
+		switch (cmd.type) {
+		case kPlayCommand:
+			if (chan)
+				deleteChannel(cmd.slot);
+			_channels[cmd.slot] = cmd.chan;
+			_slotElapsed[cmd.slot].store(0, std::memory_order_relaxed);
+			break;
+		case kStopCommand:
+			deleteChannel(cmd.slot);
+			break;
+		case kStopAllCommand:
+			for (int i = 0; i != NUM_CHANNELS; i++) {
+				if (_channels[i] != 0 && !_channels[i]->isPermanent())
+					deleteChannel(i);
+			}
+			break;
+		case kPauseCommand:
+			chan->pause(cmd.value != 0);
+			break;
+		case kPauseAllCommand:
+			for (int i = 0; i != NUM_CHANNELS; i++) {
+				if (_channels[i] != 0)
+					_channels[i]->pause(cmd.value != 0);
+			}
+			break;
+		case kVolumeCommand:
+			chan->setVolume((uint8)cmd.value);
+			break;
+		case kBalanceCommand:
+			chan->setBalance((sint8)cmd.value);
+			break;
+		case kTypeVolumeCommand:
+			for (int i = 0; i != NUM_CHANNELS; i++) {
+				if (_channels[i] && _channels[i]->getType() == cmd.value)
+					_channels[i]->notifyGlobalVolChange();
+			}
+			break;
+		}
+	}
+
+	_commandTail.store(tail, std::memory_order_release);
+}
+
+/**
+ * Make the audio thread leave the stream of a stopped channel alone, so a
+ * caller that owns the stream can reuse or delete it as soon as the stop call
+ * returns. This only waits if the stream is being read at this moment; the
+ * channel itself is deleted later by the queued stop command.
+ */
+void MixerImpl::releaseStream(int slot, uint32 handle) {
+	// both sides store then load, so either mixCallback sees the release
+	// before reading the stream or this sees it reading and waits
+	_slotReleased[slot].store(handle);
+	while (_mixingSlot.load() == slot)
+		SDL_Delay(0);
+}
+
+void MixerImpl::deleteChannel(int slot) {
+	_slotEnded[slot].store(_channels[slot]->getHandle()._val, std::memory_order_release);
+	delete _channels[slot];
+	_channels[slot] = 0;
+}
+
+void MixerImpl::insertChannel(SoundHandle *handle, Channel *chan, bool ownsStream) {
 	int index = -1;
 	for (int i = 0; i != NUM_CHANNELS; i++) {
-		if (_channels[i] == 0) {
+		if (!isSlotActive(i)) {
 			index = i;
 			break;
 		}
@@ -205,8 +342,6 @@ void MixerImpl::insertChannel(SoundHandle *handle, Channel *chan) {
 		return;
 	}
 
-	_channels[index] = chan;
-
 	SoundHandle chanHandle;
 	chanHandle._val = index + (_handleSeed * NUM_CHANNELS);
 
@@ -214,6 +349,14 @@ void MixerImpl::insertChannel(SoundHandle *handle, Channel *chan) {
 	_handleSeed++;
 	if (handle)
 		*handle = chanHandle;
+
+	_slots[index].handle = chanHandle._val;
+	_slots[index].id = chan->getId();
+	_slots[index].type = chan->getType();
+	_slots[index].permanent = chan->isPermanent();
+	_slots[index].ownsStream = ownsStream;
+
+	postCommand(kPlayCommand, index, chanHandle._val, 0, chan);
 }
 
 void MixerImpl::playStream(
@@ -224,7 +367,6 @@ void MixerImpl::playStream(
 			DisposeAfterUse::Flag autofreeStream,
 			bool permanent,
 			bool reverseStereo) {
-	Common::StackLock lock(_mutex);
 
 	if (stream == 0) {
 		//FIXME warning("stream is 0");
@@ -237,7 +379,7 @@ void MixerImpl::playStream(
 	// Prevent duplicate sounds
 	if (id != -1) {
 		for (int i = 0; i != NUM_CHANNELS; i++)
-			if (_channels[i] != 0 && _channels[i]->getId() == id) {
+			if (isSlotActive(i) && _slots[i].id == id) {
 				// Delete the stream if were asked to auto-dispose it.
 				// Note: This could cause trouble if the client code does not
 				// yet expect the stream to be gone. The primary example to
@@ -254,23 +396,20 @@ void MixerImpl::playStream(
 	reverseStereo = !reverseStereo;
 #endif
 
-	// Create the channel
+	// Create the channel. It isn't seen by the audio thread until it is queued.
 	Channel *chan = new Channel(this, type, stream, autofreeStream, reverseStereo, id, permanent);
 	chan->setVolume(volume);
 	chan->setBalance(balance);
-	insertChannel(handle, chan);
+	insertChannel(handle, chan, autofreeStream == DisposeAfterUse::YES);
 }
 
 void MixerImpl::mixCallback(uint8 *samples, uint32 len) {
 	assert(samples);
 
-	Common::StackLock lock(_mutex);
-
 	sint16 *buf = (sint16 *)samples;
 	len >>= 2;
 
-	// Since the mixer callback has been called, the mixer must be ready...
-	_mixerReady = true;
+	processCommands();
 
 	//  zero the buf
 	memset(buf, 0, 2 * len * sizeof(sint16));
@@ -278,136 +417,128 @@ void MixerImpl::mixCallback(uint8 *samples, uint32 len) {
 	// mix all channels
 	for (int i = 0; i != NUM_CHANNELS; i++)
 		if (_channels[i]) {
-			if (_channels[i]->isFinished()) {
-				delete _channels[i];
-				_channels[i] = 0;
-			} else if (!_channels[i]->isPaused())
+			_mixingSlot.store(i);
+			if (_slotReleased[i].load() == _channels[i]->getHandle()._val) {
+				// stopped, and the stream is back with its owner
+			} else if (_channels[i]->isFinished()) {
+				deleteChannel(i);
+			} else if (!_channels[i]->isPaused()) {
 				_channels[i]->mix(buf, len);
+				_slotElapsed[i].store(_channels[i]->getElapsedTime().msecs(), std::memory_order_relaxed);
+			}
 		}
+	_mixingSlot.store(-1);
 }
 
 void MixerImpl::stopAll() {
-	Common::StackLock lock(_mutex);
 	for (int i = 0; i != NUM_CHANNELS; i++) {
-		if (_channels[i] != 0 && !_channels[i]->isPermanent()) {
-			delete _channels[i];
-			_channels[i] = 0;
+		if (isSlotActive(i) && !_slots[i].permanent) {
+			if (!_slots[i].ownsStream)
+				releaseStream(i, _slots[i].handle);
+			freeSlot(i);
 		}
 	}
+	postCommand(kStopAllCommand);
 }
 
 void MixerImpl::stopID(int id) {
-	Common::StackLock lock(_mutex);
 	for (int i = 0; i != NUM_CHANNELS; i++) {
-		if (_channels[i] != 0 && _channels[i]->getId() == id) {
-			delete _channels[i];
-			_channels[i] = 0;
+		if (isSlotActive(i) && _slots[i].id == id) {
+			SoundHandle handle;
+			handle._val = _slots[i].handle;
+			stopHandle(handle);
 		}
 	}
 }
 
 void MixerImpl::stopHandle(SoundHandle handle) {
-	Common::StackLock lock(_mutex);
-
 	// Simply ignore stop requests for handles of sounds that already terminated
-	const int index = handle._val % NUM_CHANNELS;
-	if (!_channels[index] || _channels[index]->getHandle()._val != handle._val)
+	const int index = findSlot(handle);
+	if (index == -1)
 		return;
 
-	delete _channels[index];
-	_channels[index] = 0;
+	// the caller may reuse or delete a stream it still owns once this returns
+	if (!_slots[index].ownsStream)
+		releaseStream(index, handle._val);
+
+	freeSlot(index);
+	postCommand(kStopCommand, index, handle._val);
 }
 
 void MixerImpl::setChannelVolume(SoundHandle handle, uint8 volume) {
-	Common::StackLock lock(_mutex);
-
-	const int index = handle._val % NUM_CHANNELS;
-	if (!_channels[index] || _channels[index]->getHandle()._val != handle._val)
+	const int index = findSlot(handle);
+	if (index == -1)
 		return;
 
-	_channels[index]->setVolume(volume);
+	postCommand(kVolumeCommand, index, handle._val, volume);
 }
 
 void MixerImpl::setChannelBalance(SoundHandle handle, sint8 balance) {
-	Common::StackLock lock(_mutex);
-
-	const int index = handle._val % NUM_CHANNELS;
-	if (!_channels[index] || _channels[index]->getHandle()._val != handle._val)
+	const int index = findSlot(handle);
+	if (index == -1)
 		return;
 
-	_channels[index]->setBalance(balance);
+	postCommand(kBalanceCommand, index, handle._val, balance);
 }
 
 uint32 MixerImpl::getSoundElapsedTime(SoundHandle handle) {
 	return getElapsedTime(handle).msecs();
 }
 
+/* This is the time as of the last mix, so it only advances once per
+ * mixCallback().
+ */
 Timestamp MixerImpl::getElapsedTime(SoundHandle handle) {
-	Common::StackLock lock(_mutex);
-
-	const int index = handle._val % NUM_CHANNELS;
-	if (!_channels[index] || _channels[index]->getHandle()._val != handle._val)
+	const int index = findSlot(handle);
+	if (index == -1)
 		return Timestamp(0, _sampleRate);
 
-	return _channels[index]->getElapsedTime();
+	return Timestamp(_slotElapsed[index].load(std::memory_order_relaxed), _sampleRate);
 }
 
 void MixerImpl::pauseAll(bool paused) {
-	Common::StackLock lock(_mutex);
-	for (int i = 0; i != NUM_CHANNELS; i++) {
-		if (_channels[i] != 0) {
-			_channels[i]->pause(paused);
-		}
-	}
+	postCommand(kPauseAllCommand, -1, 0xFFFFFFFF, paused);
 }
 
 void MixerImpl::pauseID(int id, bool paused) {
-	Common::StackLock lock(_mutex);
 	for (int i = 0; i != NUM_CHANNELS; i++) {
-		if (_channels[i] != 0 && _channels[i]->getId() == id) {
-			_channels[i]->pause(paused);
+		if (isSlotActive(i) && _slots[i].id == id) {
+			postCommand(kPauseCommand, i, _slots[i].handle, paused);
 			return;
 		}
 	}
 }
 
 void MixerImpl::pauseHandle(SoundHandle handle, bool paused) {
-	Common::StackLock lock(_mutex);
-
 	// Simply ignore (un)pause requests for sounds that already terminated
-	const int index = handle._val % NUM_CHANNELS;
-	if (!_channels[index] || _channels[index]->getHandle()._val != handle._val)
+	const int index = findSlot(handle);
+	if (index == -1)
 		return;
 
-	_channels[index]->pause(paused);
+	postCommand(kPauseCommand, index, handle._val, paused);
 }
 
 bool MixerImpl::isSoundIDActive(int id) {
-	Common::StackLock lock(_mutex);
 	for (int i = 0; i != NUM_CHANNELS; i++)
-		if (_channels[i] && _channels[i]->getId() == id)
+		if (isSlotActive(i) && _slots[i].id == id)
 			return true;
 	return false;
 }
 
 int MixerImpl::getSoundID(SoundHandle handle) {
-	Common::StackLock lock(_mutex);
-	const int index = handle._val % NUM_CHANNELS;
-	if (_channels[index] && _channels[index]->getHandle()._val == handle._val)
-		return _channels[index]->getId();
+	const int index = findSlot(handle);
+	if (index != -1)
+		return _slots[index].id;
 	return 0;
 }
 
 bool MixerImpl::isSoundHandleActive(SoundHandle handle) {
-	Common::StackLock lock(_mutex);
-	const int index = handle._val % NUM_CHANNELS;
-	return _channels[index] && _channels[index]->getHandle()._val == handle._val;
+	return findSlot(handle) != -1;
 }
 
 bool MixerImpl::hasActiveChannelOfType(SoundType type) {
-	Common::StackLock lock(_mutex);
 	for (int i = 0; i != NUM_CHANNELS; i++)
-		if (_channels[i] && _channels[i]->getType() == type)
+		if (isSlotActive(i) && _slots[i].type == type)
 			return true;
 	return false;
 }
@@ -424,13 +555,9 @@ void MixerImpl::setVolumeForSoundType(SoundType type, int volume) {
 	// TODO: Maybe we should do logarithmic (not linear) volume
 	// scaling? See also Player_V2::setMasterVolume
 
-	Common::StackLock lock(_mutex);
 	_volumeForSoundType[type] = volume;
 
-	for (int i = 0; i != NUM_CHANNELS; ++i) {
-		if (_channels[i] && _channels[i]->getType() == type)
-			_channels[i]->notifyGlobalVolChange();
-	}
+	postCommand(kTypeVolumeCommand, -1, 0xFFFFFFFF, type);
 }
 
 int MixerImpl::getVolumeForSoundType(SoundType type) const {
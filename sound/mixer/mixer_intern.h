@@ -27,7 +27,7 @@
 #define SOUND_MIXER_INTERN_H
 
 //#include "common/scummsys.h"
-#include "mutex.h"
+#include <atomic>
 #include "mixer.h"
 
 namespace Audio {
@@ -42,38 +42,91 @@ namespace Audio {
  * 1) Creat a new Audio::MixerImpl instance.
  * 2) Set the hardware output sample rate via the setSampleRate() method.
  * 3) Hook up the mixCallback() in a suitable audio processing thread/callback.
- * 4) Change the mixer into ready mode via setReady(true).
- * 5) Start audio processing (e.g. by resuming the audio thread, if applicable).
+ * 4) Start audio processing (e.g. by resuming the audio thread, if applicable).
+ * 5) Change the mixer into ready mode via setReady(true).
+ * When shutting down, stop the audio processing before setReady(false).
  *
  * In the future, we might make it possible for backends to provide
  * (partial) alternative implementations of the mixer, e.g. to make
  * better use of native sound mixing support on low-end devices.
  *
+ * No lock is shared with the audio thread. The calling thread keeps its own
+ * record of which channel slots are in use and posts every change as a
+ * command into a single producer, single consumer queue. mixCallback()
+ * applies the queued commands before mixing, and reports finished channels
+ * and elapsed times back through atomics. All the public methods must be
+ * called from one thread.
+ *
  * @see OSystem::getMixer()
  */
 class MixerImpl : public Mixer {
 private:
 	enum {
-		NUM_CHANNELS = 16
+		NUM_CHANNELS = 16,
+		COMMAND_QUEUE_SIZE = 1024 // must be a power of two
+	};
+
+	enum CommandType {
+		kPlayCommand,
+		kStopCommand,
+		kStopAllCommand,
+		kPauseCommand,
+		kPauseAllCommand,
+		kVolumeCommand,
+		kBalanceCommand,
+		kTypeVolumeCommand
+	};
+
+	struct Command {
+		CommandType type;
+		int slot;
+		uint32 handle;
+		Channel *chan; // new channel for kPlayCommand
+		int value;
+	};
+
+	/** The calling thread's view of a channel slot. */
+	struct SlotState {
+		uint32 handle; // 0xFFFFFFFF when free
+		int id;
+		SoundType type;
+		bool permanent;
+		bool ownsStream; // stream is deleted by the mixer
 	};
 
 	//OSystem *_syst;
-	Common::Mutex _mutex;
 
 	const uint32 _sampleRate;
-	bool _mixerReady;
+	std::atomic<bool> _mixerReady;
 	uint32 _handleSeed;
 
-	int _volumeForSoundType[4];
+	std::atomic<int> _volumeForSoundType[4];
+
+	// owned by the audio thread
 	Channel *_channels[NUM_CHANNELS];
 
+	// owned by the calling thread
+	SlotState _slots[NUM_CHANNELS];
+
+	// written by the audio thread
+	std::atomic<uint32> _slotEnded[NUM_CHANNELS]; // handle of the last channel to finish in each slot
+	std::atomic<uint32> _slotElapsed[NUM_CHANNELS]; // msecs played, as of the last mix
+	std::atomic<int> _mixingSlot; // slot whose stream is being read, or -1
+
+	// written by the calling thread
+	std::atomic<uint32> _slotReleased[NUM_CHANNELS]; // handle of a stopped channel whose stream the caller owns
+
+	Command _commands[COMMAND_QUEUE_SIZE];
+	std::atomic<uint32> _commandHead; // next command to be posted
+	std::atomic<uint32> _commandTail; // next command to be applied
+
 
 public:
 
 	MixerImpl(uint32 sampleRate);
 	~MixerImpl();
 
-	virtual bool isReady() const { return _mixerReady; }
+	virtual bool isReady() const { return _mixerReady.load(); }
 
 	virtual void playStream(
 		SoundType type,
@@ -111,7 +164,17 @@ public:
 	virtual uint32 getOutputRate() const;
 
 protected:
-	void insertChannel(SoundHandle *handle, Channel *chan);
+	void insertChannel(SoundHandle *handle, Channel *chan, bool ownsStream);
+
+	int findSlot(SoundHandle handle) const;
+	bool isSlotActive(int slot) const;
+	void freeSlot(int slot);
+
+	void postCommand(CommandType type, int slot = -1, uint32 handle = 0xFFFFFFFF, int value = 0, Channel *chan = 0);
+	void waitForCommands();
+	void processCommands();
+	void deleteChannel(int slot);
+	void releaseStream(int slot, uint32 handle);
 
 public:
 	/**
@@ -124,7 +187,9 @@ public:
 	/**
 	 * Set the internal 'is ready' flag of the mixer.
 	 * Backends should invoke Mixer::setReady(true) once initialisation of
-	 * their audio system has been completed.
+	 * their audio system has been completed and mixCallback() is being
+	 * called. While not ready, queued commands are applied by the calling
+	 * thread, so it must only be cleared once mixCallback() has stopped.
 	 */
 	void setReady(bool ready);
 };
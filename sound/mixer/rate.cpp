@@ -39,6 +39,12 @@
 #include "frac.h"
 //#include "common/util.h"
 
+// SSE2 is always there on x86-64, so it doesn't need its own build flags
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(OUTPUT_UNSIGNED_AUDIO)
+#define AUDIO_MIX_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Audio {
 
 
@@ -50,6 +56,82 @@ namespace Audio {
  */
 #define INTERMEDIATE_BUFFER_SIZE 512
 
+#ifdef AUDIO_MIX_SSE2
+// mixSSE2() divides by kMaxMixerVolume with a shift
+static_assert(Audio::Mixer::kMaxMixerVolume == 256, "mixSSE2 expects kMaxMixerVolume to be 256");
+
+/**
+ * Scale eight output samples (four pairs) by their volumes and add them to
+ * obuf with saturation. The result is the same as clampedAdd() with
+ * (sample * vol) / Audio::Mixer::kMaxMixerVolume on each of them.
+ */
+static inline void mixSSE2(st_sample_t *obuf, __m128i samples, __m128i vol) {
+	const __m128i lo = _mm_mullo_epi16(samples, vol);
+	const __m128i hi = _mm_mulhi_epi16(samples, vol);
+	__m128i p0 = _mm_unpacklo_epi16(lo, hi);
+	__m128i p1 = _mm_unpackhi_epi16(lo, hi);
+
+	// divide by kMaxMixerVolume (256), rounding towards zero like C does
+	const __m128i round = _mm_set1_epi32(Audio::Mixer::kMaxMixerVolume - 1);
+	p0 = _mm_srai_epi32(_mm_add_epi32(p0, _mm_and_si128(_mm_srai_epi32(p0, 31), round)), 8);
+	p1 = _mm_srai_epi32(_mm_add_epi32(p1, _mm_and_si128(_mm_srai_epi32(p1, 31), round)), 8);
+
+	__m128i out = _mm_loadu_si128((const __m128i *)obuf);
+	out = _mm_adds_epi16(out, _mm_packs_epi32(p0, p1));
+	_mm_storeu_si128((__m128i *)obuf, out);
+}
+#endif
+
+/**
+ * Mix `len' sample pairs made from the input samples in `ibuf' into `obuf',
+ * scaling the left and right channels by vol_l and vol_r. Mono input is
+ * used for both channels.
+ */
+template<bool stereo, bool reverseStereo>
+static void mixSamples(st_sample_t *obuf, const st_sample_t *ibuf, st_size_t len, st_volume_t vol_l, st_volume_t vol_r) {
+#ifdef AUDIO_MIX_SSE2
+	if (stereo) {
+		// reversed pairs are swapped before scaling, so the volumes swap too
+		const __m128i vol = reverseStereo ?
+			_mm_setr_epi16(vol_r, vol_l, vol_r, vol_l, vol_r, vol_l, vol_r, vol_l) :
+			_mm_setr_epi16(vol_l, vol_r, vol_l, vol_r, vol_l, vol_r, vol_l, vol_r);
+
+		for (; len >= 4; len -= 4) {
+			__m128i in = _mm_loadu_si128((const __m128i *)ibuf);
+			if (reverseStereo)
+				in = _mm_shufflehi_epi16(_mm_shufflelo_epi16(in, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			mixSSE2(obuf, in, vol);
+			ibuf += 8;
+			obuf += 8;
+		}
+	} else {
+		const __m128i vol = _mm_setr_epi16(vol_l, vol_r, vol_l, vol_r, vol_l, vol_r, vol_l, vol_r);
+
+		for (; len >= 8; len -= 8) {
+			const __m128i in = _mm_loadu_si128((const __m128i *)ibuf);
+			mixSSE2(obuf, _mm_unpacklo_epi16(in, in), vol);
+			mixSSE2(obuf + 8, _mm_unpackhi_epi16(in, in), vol);
+			ibuf += 8;
+			obuf += 16;
+		}
+	}
+#endif
+
+	for (; len > 0; len--) {
+		st_sample_t out0, out1;
+		out0 = *ibuf++;
+		out1 = (stereo ? *ibuf++ : out0);
+
+		// output left channel
+		clampedAdd(obuf[reverseStereo    ], (out0 * (int)vol_l) / Audio::Mixer::kMaxMixerVolume);
+
+		// output right channel
+		clampedAdd(obuf[reverseStereo ^ 1], (out1 * (int)vol_r) / Audio::Mixer::kMaxMixerVolume);
+
+		obuf += 2;
+	}
+}
+
 
 /**
  * Audio rate converter based on simple resampling. Used when no
@@ -109,8 +191,14 @@ template<bool stereo, bool reverseStereo>
 int SimpleRateConverter<stereo, reverseStereo>::flow(AudioStream &input, st_sample_t *obuf, st_size_t osamp, st_volume_t vol_l, st_volume_t vol_r) {
 	st_sample_t *ostart, *oend;
 
+	// picked samples are collected here and mixed into obuf a block at a time
+	st_sample_t mixBuf[INTERMEDIATE_BUFFER_SIZE];
+	st_sample_t *mixStart;
+	int mixLen = 0;
+
 	ostart = obuf;
 	oend = obuf + osamp * 2;
+	mixStart = obuf;
 
 	while (obuf < oend) {
 
@@ -120,8 +208,10 @@ int SimpleRateConverter<stereo, reverseStereo>::flow(AudioStream &input, st_samp
 			if (inLen == 0) {
 				inPtr = inBuf;
 				inLen = input.readBuffer(inBuf, ARRAYSIZE(inBuf));
-				if (inLen <= 0)
+				if (inLen <= 0) {
+					mixSamples<stereo, reverseStereo>(mixStart, mixBuf, (obuf - mixStart) / 2, vol_l, vol_r);
 					return (obuf - ostart) / 2;
+				}
 			}
 			inLen -= (stereo ? 2 : 1);
 			opos--;
@@ -130,21 +220,22 @@ int SimpleRateConverter<stereo, reverseStereo>::flow(AudioStream &input, st_samp
 			}
 		} while (opos >= 0);
 
-		st_sample_t out0, out1;
-		out0 = *inPtr++;
-		out1 = (stereo ? *inPtr++ : out0);
+		mixBuf[mixLen++] = *inPtr++;
+		if (stereo)
+			mixBuf[mixLen++] = *inPtr++;
 
 		// Increment output position
 		opos += opos_inc;
 
-		// output left channel
-		clampedAdd(obuf[reverseStereo    ], (out0 * (int)vol_l) / Audio::Mixer::kMaxMixerVolume);
-
-		// output right channel
-		clampedAdd(obuf[reverseStereo ^ 1], (out1 * (int)vol_r) / Audio::Mixer::kMaxMixerVolume);
-
 		obuf += 2;
+
+		if (mixLen == ARRAYSIZE(mixBuf)) {
+			mixSamples<stereo, reverseStereo>(mixStart, mixBuf, (obuf - mixStart) / 2, vol_l, vol_r);
+			mixStart = obuf;
+			mixLen = 0;
+		}
 	}
+	mixSamples<stereo, reverseStereo>(mixStart, mixBuf, (obuf - mixStart) / 2, vol_l, vol_r);
 	return (obuf - ostart) / 2;
 }
 
@@ -218,8 +309,14 @@ template<bool stereo, bool reverseStereo>
 int LinearRateConverter<stereo, reverseStereo>::flow(AudioStream &input, st_sample_t *obuf, st_size_t osamp, st_volume_t vol_l, st_volume_t vol_r) {
 	st_sample_t *ostart, *oend;
 
+	// interpolated samples are collected here and mixed into obuf a block at a time
+	st_sample_t mixBuf[INTERMEDIATE_BUFFER_SIZE];
+	st_sample_t *mixStart;
+	int mixLen = 0;
+
 	ostart = obuf;
 	oend = obuf + osamp * 2;
+	mixStart = obuf;
 
 	while (obuf < oend) {
 
@@ -229,8 +326,10 @@ int LinearRateConverter<stereo, reverseStereo>::flow(AudioStream &input, st_samp
 			if (inLen == 0) {
 				inPtr = inBuf;
 				inLen = input.readBuffer(inBuf, ARRAYSIZE(inBuf));
-				if (inLen <= 0)
+				if (inLen <= 0) {
+					mixSamples<stereo, reverseStereo>(mixStart, mixBuf, (obuf - mixStart) / 2, vol_l, vol_r);
 					return (obuf - ostart) / 2;
+				}
 			}
 			inLen -= (stereo ? 2 : 1);
 			ilast0 = icur0;
@@ -246,24 +345,23 @@ int LinearRateConverter<stereo, reverseStereo>::flow(AudioStream &input, st_samp
 		// still space in the output buffer.
 		while (opos < (frac_t)FRAC_ONE && obuf < oend) {
 			// interpolate
-			st_sample_t out0, out1;
-			out0 = (st_sample_t)(ilast0 + (((icur0 - ilast0) * opos + FRAC_HALF) >> FRAC_BITS));
-			out1 = (stereo ?
-						  (st_sample_t)(ilast1 + (((icur1 - ilast1) * opos + FRAC_HALF) >> FRAC_BITS)) :
-						  out0);
-
-			// output left channel
-			clampedAdd(obuf[reverseStereo    ], (out0 * (int)vol_l) / Audio::Mixer::kMaxMixerVolume);
-
-			// output right channel
-			clampedAdd(obuf[reverseStereo ^ 1], (out1 * (int)vol_r) / Audio::Mixer::kMaxMixerVolume);
+			mixBuf[mixLen++] = (st_sample_t)(ilast0 + (((icur0 - ilast0) * opos + FRAC_HALF) >> FRAC_BITS));
+			if (stereo)
+				mixBuf[mixLen++] = (st_sample_t)(ilast1 + (((icur1 - ilast1) * opos + FRAC_HALF) >> FRAC_BITS));
 
 			obuf += 2;
 
 			// Increment output position
 			opos += opos_inc;
+
+			if (mixLen == ARRAYSIZE(mixBuf)) {
+				mixSamples<stereo, reverseStereo>(mixStart, mixBuf, (obuf - mixStart) / 2, vol_l, vol_r);
+				mixStart = obuf;
+				mixLen = 0;
+			}
 		}
 	}
+	mixSamples<stereo, reverseStereo>(mixStart, mixBuf, (obuf - mixStart) / 2, vol_l, vol_r);
 	return (obuf - ostart) / 2;
 }
 
@@ -304,22 +402,15 @@ public:
 
 		// Read up to 'osamp' samples into our temporary buffer
 		len = input.readBuffer(_buffer, osamp);
+		if ((int)len <= 0)
+			return 0;
 
 		// Mix the data into the output buffer
 		ptr = _buffer;
-		for (; len > 0; len -= (stereo ? 2 : 1)) {
-			st_sample_t out0, out1;
-			out0 = *ptr++;
-			out1 = (stereo ? *ptr++ : out0);
-
-			// output left channel
-			clampedAdd(obuf[reverseStereo    ], (out0 * (int)vol_l) / Audio::Mixer::kMaxMixerVolume);
-
-			// output right channel
-			clampedAdd(obuf[reverseStereo ^ 1], (out1 * (int)vol_r) / Audio::Mixer::kMaxMixerVolume);
+		len = (stereo ? (len + 1) / 2 : len);
+		mixSamples<stereo, reverseStereo>(obuf, ptr, len, vol_l, vol_r);
+		obuf += len * 2;
 
-			obuf += 2;
-		}
 		return (obuf - ostart) / 2;
 	}
 
@@ -46,10 +46,11 @@ SdlMixerManager::SdlMixerManager()
 }
 
 SdlMixerManager::~SdlMixerManager() {
-	_mixer->setReady(false);
-
 	SDL_CloseAudio();
 
+	// only once the callback has stopped may queued commands be applied here
+	_mixer->setReady(false);
+
 	delete _mixer;
 }
 
@@ -74,9 +75,9 @@ void SdlMixerManager::init() {
 
 		_mixer = new Audio::MixerImpl(_obtainedRate.freq);
 		assert(_mixer); 
-		_mixer->setReady(true);
 
 		startAudio();
+		_mixer->setReady(true);
 	}
 }
 
@@ -128,6 +129,8 @@ void SdlMixerManager::sdlCallback(void *this_, uint8 *samples, int len) {
 
 void SdlMixerManager::suspendAudio() {
 	SDL_CloseAudio();
+	// the callback has stopped, queued mixer commands are applied by the caller now
+	_mixer->setReady(false);
 	_audioSuspended = true;
 }
 
@@ -138,6 +141,7 @@ int SdlMixerManager::resumeAudio() {
 		return -1;
 	}
 	SDL_PauseAudio(0);
+	_mixer->setReady(true);
 	_audioSuspended = false;
 	return 0;
 }
@@ -428,7 +428,12 @@ bool U6UseCode::uc_event(const U6ObjectType *type, UseCodeEvent ev, Obj *obj)
     if(type->trigger & ev)
     {
         dbg_print_event(ev, obj);
+        // usecode may change the object's frame, so its location may change passability
+        bool on_map = obj && obj->is_on_map();
+        MapCoord loc = on_map ? MapCoord(obj) : MapCoord();
         bool ucret = (this->*type->usefunc)(obj, ev);
+        if(on_map)
+            obj_manager->invalidate_passable(loc.x, loc.y, loc.z);
         clear_items(); // clear references for next call
         return(ucret); // return from usecode function
     }
@@ -680,7 +685,7 @@ bool U6UseCode::use_switch(Obj *obj, UseCodeEvent ev)
      }
     else //delete barrier object.
      {
-      obj_list->remove(portc_obj);
+      obj_manager->remove_obj_from_map(portc_obj);
       delete_obj(portc_obj);
      }
    }